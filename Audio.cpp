@@ -45,16 +45,40 @@ void KEngineBasics::AudioSystem::Deinit()
 		}
 	}
 	mLoadedSounds.clear();
+	mNameHandles.clear();
+	mNameHandleAddresses.clear();
 	Mix_CloseAudio();
 }
 
+// Reads the argument at index, a name or a handle from audio.handle, as a hash.
+static KEngineCore::StringHash CheckName(lua_State* luaState, int index, KEngineBasics::AudioSystem* audioSystem)
+{
+	if (lua_type(luaState, index) == LUA_TLIGHTUSERDATA)
+	{
+		const KEngineCore::StringHash* handle = audioSystem->FindNameHandle(lua_touserdata(luaState, index));
+		if (handle == nullptr)
+		{
+			luaL_argerror(luaState, index, "not a handle from audio.handle");
+		}
+		return *handle;
+	}
+	return KEngineCore::StringHash(luaL_checkstring(luaState, index));
+}
+
 void KEngineBasics::AudioSystem::RegisterLibrary(lua_State* luaState, char const* name)
 {
 	auto luaopen_audio = [](lua_State* luaState) {
+		// audio.handle(name) hashes a name once; playMusic and playSound take the handle in its place.
+		auto handle = [](lua_State* luaState) {
+			AudioSystem* audioSystem = (AudioSystem*)lua_touserdata(luaState, lua_upvalueindex(1));
+			lua_pushlightuserdata(luaState, (void*)audioSystem->GetNameHandle(luaL_checkstring(luaState, 1)));
+			return 1;
+		};
+
 		auto playMusic = [](lua_State* luaState) {
 			AudioSystem* audioSystem = (AudioSystem*)lua_touserdata(luaState, lua_upvalueindex(1));
 			KEngineCore::LuaScheduler* scheduler = audioSystem->mLuaScheduler;
-			KEngineCore::StringHash musicName(luaL_checkstring(luaState, 1));
+			KEngineCore::StringHash musicName = CheckName(luaState, 1, audioSystem);
 			audioSystem->PlayMusic(musicName);
 			return 0;
 		};
@@ -63,12 +87,13 @@ void KEngineBasics::AudioSystem::RegisterLibrary(lua_State* luaState, char const
 		auto playSound = [](lua_State* luaState) {
 			AudioSystem* audioSystem = (AudioSystem*)lua_touserdata(luaState, lua_upvalueindex(1));
 			KEngineCore::LuaScheduler* scheduler = audioSystem->mLuaScheduler;
-			KEngineCore::StringHash soundName(luaL_checkstring(luaState, 1));
+			KEngineCore::StringHash soundName = CheckName(luaState, 1, audioSystem);
 			audioSystem->PlaySound(soundName);
 			return 0;
 		};
 		
 		const luaL_Reg audioLibrary[] = {
+			{"handle", handle},
 			{"playMusic", playMusic},
 			{"playSound", playSound},
 			{nullptr, nullptr}
@@ -151,6 +176,18 @@ KEngineBasics::Sound* KEngineBasics::AudioSystem::PlaySound(KEngineCore::StringH
 	return nullptr;
 }
 
+const KEngineCore::StringHash* KEngineBasics::AudioSystem::GetNameHandle(KEngineCore::StringHash name)
+{
+	const KEngineCore::StringHash* handle = &*mNameHandles.insert(name).first;
+	mNameHandleAddresses.insert(handle);
+	return handle;
+}
+
+const KEngineCore::StringHash* KEngineBasics::AudioSystem::FindNameHandle(const void* pointer) const
+{
+	return mNameHandleAddresses.contains(pointer) ? (const KEngineCore::StringHash*)pointer : nullptr;
+}
+
 KEngineBasics::Sound::Sound()
 {
 }
@@ -9,6 +9,7 @@
 #endif
 #include <functional>
 #include <map>
+#include <set>
 
 namespace KEngineCore
 {
@@ -55,6 +56,11 @@ namespace KEngineBasics {
 
 		Sound * PlaySound(KEngineCore::StringHash soundId, bool isVoice = false, std::function<void()> onComplete = nullptr);
 		void RecycleSound(Sound* sound);
+
+		// Stable address of name, for audio.handle.  Valid until Deinit.
+		const KEngineCore::StringHash* GetNameHandle(KEngineCore::StringHash name);
+		// The handle at pointer, or nullptr if pointer isn't a handle GetNameHandle gave out.
+		const KEngineCore::StringHash* FindNameHandle(const void* pointer) const;
 	private:
 		KEngineCore::LuaScheduler*	mLuaScheduler;
         KEngineCore::Logger*        mLogger;
@@ -62,6 +68,8 @@ namespace KEngineBasics {
 
 		std::map<KEngineCore::StringHash, Mix_Music*> mLoadedMusic;
 		std::map<KEngineCore::StringHash, Mix_Chunk*> mLoadedSounds;
+		std::set<KEngineCore::StringHash> mNameHandles;
+		std::set<const void*> mNameHandleAddresses;
 
 	};
 
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace KEngineBasics {
+
+	static constexpr size_t DefaultInlineFunctionCapacity = 64;
+
+	// Drop-in replacement for std::function that stores its callable inline and never touches the heap.  A
+	// callable too large for Capacity is a compile error rather than a hidden allocation.  Capacity defaults to
+	// enough for a std::function itself, so callbacks that only come as std::function (ScheduledLuaCallback)
+	// can still be stored, at the price of std::function's own call overhead.
+	template<typename Signature, size_t Capacity = DefaultInlineFunctionCapacity>
+	class InlineFunction;
+
+	template<typename Result, typename... Args, size_t Capacity>
+	class InlineFunction<Result(Args...), Capacity>
+	{
+	public:
+		InlineFunction() = default;
+		InlineFunction(std::nullptr_t) {}
+
+		template<typename Callable, typename = std::enable_if_t<!std::is_same_v<std::decay_t<Callable>, InlineFunction> && std::is_invocable_r_v<Result, std::decay_t<Callable>&, Args...>>>
+		InlineFunction(Callable&& callable) {
+			typedef std::decay_t<Callable> Stored;
+			static_assert(sizeof(Stored) <= Capacity, "Callable is too large for this InlineFunction's Capacity");
+			static_assert(alignof(Stored) <= alignof(std::max_align_t), "Callable is over-aligned for InlineFunction");
+			static_assert(std::is_copy_constructible_v<Stored>, "InlineFunction requires a copyable callable");
+			if constexpr (IsNullable<Stored>::value)
+			{
+				if (!callable)
+				{
+					return;
+				}
+			}
+			new (mStorage) Stored(std::forward<Callable>(callable));
+			mInvoke = &Invoke<Stored>;
+			mManage = &Manage<Stored>;
+		}
+
+		InlineFunction(const InlineFunction& other) {
+			CopyFrom(other);
+		}
+
+		InlineFunction(InlineFunction&& other) noexcept {
+			MoveFrom(other);
+		}
+
+		~InlineFunction() {
+			Reset();
+		}
+
+		InlineFunction& operator=(const InlineFunction& other) {
+			if (this != &other)
+			{
+				Reset();
+				CopyFrom(other);
+			}
+			return *this;
+		}
+
+		InlineFunction& operator=(InlineFunction&& other) noexcept {
+			if (this != &other)
+			{
+				Reset();
+				MoveFrom(other);
+			}
+			return *this;
+		}
+
+		InlineFunction& operator=(std::nullptr_t) {
+			Reset();
+			return *this;
+		}
+
+		explicit operator bool() const {
+			return mInvoke != nullptr;
+		}
+
+		Result operator()(Args... args) const {
+			assert(mInvoke != nullptr);
+			return mInvoke(mStorage, std::forward<Args>(args)...);
+		}
+
+	private:
+		enum Operation {
+			CopyOperation,
+			MoveOperation,
+			DestroyOperation
+		};
+
+		template<typename Stored>
+		struct IsNullable : std::bool_constant<std::is_pointer_v<Stored> || std::is_member_pointer_v<Stored>> {};
+
+		template<typename Signature>
+		struct IsNullable<std::function<Signature>> : std::true_type {};
+
+		template<typename Stored>
+		static Result Invoke(void* storage, Args&&... args) {
+			return std::invoke(*static_cast<Stored*>(storage), std::forward<Args>(args)...);
+		}
+
+		template<typename Stored>
+		static void Manage(Operation operation, void* destination, void* source) {
+			switch (operation)
+			{
+			case CopyOperation:
+				new (destination) Stored(*static_cast<const Stored*>(source));
+				break;
+			case MoveOperation:
+				new (destination) Stored(std::move(*static_cast<Stored*>(source)));
+				static_cast<Stored*>(source)->~Stored();
+				break;
+			case DestroyOperation:
+				static_cast<Stored*>(destination)->~Stored();
+				break;
+			}
+		}
+
+		void CopyFrom(const InlineFunction& other) {
+			if (other.mManage != nullptr)
+			{
+				other.mManage(CopyOperation, mStorage, other.mStorage);
+				mInvoke = other.mInvoke;
+				mManage = other.mManage;
+			}
+		}
+
+		void MoveFrom(InlineFunction& other) {
+			if (other.mManage != nullptr)
+			{
+				other.mManage(MoveOperation, mStorage, other.mStorage);
+				mInvoke = other.mInvoke;
+				mManage = other.mManage;
+				other.mInvoke = nullptr;
+				other.mManage = nullptr;
+			}
+		}
+
+		void Reset() {
+			if (mManage != nullptr)
+			{
+				mManage(DestroyOperation, mStorage, nullptr);
+				mInvoke = nullptr;
+				mManage = nullptr;
+			}
+		}
+
+		alignas(std::max_align_t) mutable unsigned char	mStorage[Capacity];
+		Result	(*mInvoke)(void*, Args&&...){ nullptr };
+		void	(*mManage)(Operation, void*, void*){ nullptr };
+	};
+}
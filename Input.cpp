@@ -1,15 +1,50 @@
 #include "Input.h"
+#include "InputMapping.h"
 #include "LuaScheduler.h"
+#include "Logger.h"
 #include <StringHash.h>
 #include <algorithm>
+#include <bit>
+#include <cmath>
+#include <utility>
 
 using namespace KEngineBasics;
 
+#ifdef KENGINE_INPUT_INSTRUMENTATION
+#define KENGINE_INPUT_INSTRUMENT(statement) statement
+#else
+#define KENGINE_INPUT_INSTRUMENT(statement)
+#endif
+
+// Stamps events that reach Input without an ingestion time.  Combo timing and cursor samples go by this
+// time rather than when dispatch gets to the event, so replayed and batched input times out as it did live.
+static std::chrono::steady_clock::time_point StampIngestion(std::chrono::steady_clock::time_point timestamp)
+{
+	if (timestamp == std::chrono::steady_clock::time_point{})
+	{
+		return std::chrono::steady_clock::now();
+	}
+	return timestamp;
+}
+
+// Dead zone, response curve, inversion and smoothing for one axis value.  partner is the other axis of a
+// radial pair (0 otherwise), so that the dead zone measures the stick's length.  Branch-free, so that the
+// loop over an AxisBatch vectorizes.
+static inline float ConditionAxis(float raw, float partner, float deadZone, float exponent, float scale, float smoothing, float previous)
+{
+	float magnitude = std::sqrt(raw * raw + partner * partner);
+	float live = std::clamp((magnitude - deadZone) / (1.0f - deadZone), 0.0f, 1.0f);
+	float target = raw * scale * std::pow(live, exponent) / std::max(magnitude, 1e-6f);
+	return target + (previous - target) * smoothing;
+}
+
 
 const char KEngineBasics::CombinedAxisBinding::MetaName[] = "KEngineBasics.CombinedAxisBinding";
 const char KEngineBasics::ButtonDownBinding::MetaName[] = "KEngineBasics.ButtonDownBinding";
 const char KEngineBasics::ButtonHoldBinding::MetaName[] = "KEngineBasics.ButtonHoldBinding";
 const char KEngineBasics::ButtonUpBinding::MetaName[] = "KEngineBasics.ButtonUpBinding";
+const char KEngineBasics::ComboBinding::MetaName[] = "KEngineBasics.ComboBinding";
+const char KEngineBasics::InputBindingSet::MetaName[] = "KEngineBasics.InputBindingSet";
 
 Input::Input()
 {
@@ -22,77 +57,93 @@ Input::~Input()
 	Deinit();
 }
 
-void Input::Init(KEngineCore::LuaScheduler* scheduler, KEngineCore::Timer* timer)
+void Input::Init(KEngineCore::LuaScheduler* scheduler, KEngineCore::Timer* timer, KEngineCore::Logger* logger)
 {
 	assert(mScheduler == nullptr);
 	mScheduler = scheduler;
 	mTimer = timer;
+	mLogger = logger;
+	if (mPauseJournal.empty())
+	{
+		SetPauseJournalCapacity(DefaultPauseJournalCapacity);
+	}
+	if (mPostedEvents.GetCapacity() == 0)
+	{
+		SetPostedEventCapacity(DefaultPostedEventCapacity);
+	}
+	if (mContexts.empty())
+	{
+		AddContext("default");
+		PushContext("default");
+	}
+	KENGINE_INPUT_INSTRUMENT(mPendingLuaResumes.reserve(DefaultPendingLuaResumeCapacity));
 }
 
 void Input::Deinit()
 {
-	for (auto binding : mCombinedAxisBindings.mBindings)
-	{
-		mCombinedAxisBindings.mProcessingBinding = binding;
+	mCombinedAxisBindings.ForEach([](CombinedAxisBinding* binding) {
 		binding->Deinit();
-	}
-	mCombinedAxisBindings.mBindings.clear();
-
-	for (auto binding : mVirtualAxisBindings.mBindings)
-	{
-		mVirtualAxisBindings.mProcessingBinding = binding;
-		binding->Deinit();
-	}
-	mVirtualAxisBindings.mBindings.clear();
+	});
+	mCombinedAxisBindings.Clear();
 
-	for (auto& bindingGroupPair : mAxisBindings)
+	for (PlayerInput& player : mPlayers)
 	{
-		auto& bindingGroup = bindingGroupPair.second;
-		for (auto binding : bindingGroup.mBindings)
+		for (auto& channelPair : player.mVirtualAxes)
 		{
-			bindingGroup.mProcessingBinding = binding;
-			binding->Deinit();
+			channelPair.second.mBindings.ForEach([](VirtualAxisBinding* binding) {
+				binding->Deinit();
+			});
 		}
-		bindingGroup.mProcessingBinding = nullptr;
-	}
-	mAxisBindings.clear();
+		player.mVirtualAxes.clear();
 
-	for (auto bindingGroupPair : mCursorPositionBindings)
-	{
-		auto& bindingGroup = bindingGroupPair.second;
-		for (auto binding : bindingGroup.mBindings)
+		for (auto& bindingGroupPair : player.mAxisBindings)
 		{
-			bindingGroup.mProcessingBinding = binding;
-			binding->Deinit();
+			bindingGroupPair.second.ForEach([](AxisBinding* binding) {
+				binding->Deinit();
+			});
 		}
-		bindingGroup.mProcessingBinding = nullptr;
-	}
-	mCursorPositionBindings.clear();
+		player.mAxisBindings.clear();
 
-	for (auto& bindingPackPair : mButtonBindings)
-	{
-		auto& bindingPack = bindingPackPair.second;
-		for (auto binding : bindingPack.mButtonHoldBindings.mBindings)
+		for (auto& channelPair : player.mCursorChannels)
 		{
-			bindingPack.mButtonHoldBindings.mProcessingBinding = binding;
-			binding->Deinit();
+			channelPair.second.mEachEventBindings.ForEach([](CursorPositionBinding* binding) {
+				binding->Deinit();
+			});
+			channelPair.second.mPerFrameBindings.ForEach([](CursorPositionBinding* binding) {
+				binding->Deinit();
+			});
 		}
-		bindingPack.mButtonHoldBindings.mProcessingBinding = nullptr;
-		for (auto binding : bindingPack.mButtonUpBindings.mBindings)
+		player.mCursorChannels.clear();
+
+		for (auto& bindingPackPair : player.mButtonBindings)
 		{
-			bindingPack.mButtonUpBindings.mProcessingBinding = binding;
-			binding->Deinit();
+			auto& bindingPack = bindingPackPair.second;
+			bindingPack.mButtonHoldBindings.ForEach([](ButtonHoldBinding* binding) {
+				binding->Deinit();
+			});
+			bindingPack.mButtonUpBindings.ForEach([](ButtonUpBinding* binding) {
+				binding->Deinit();
+			});
+			bindingPack.mButtonDownBindings.ForEach([](ButtonDownBinding* binding) {
+				binding->Deinit();
+			});
 		}
-		bindingPack.mButtonUpBindings.mProcessingBinding = nullptr;
-		for (auto binding : bindingPack.mButtonDownBindings.mBindings)
+
+		for (auto& bindingGroupPair : player.mComboBindings)
 		{
-			bindingPack.mButtonDownBindings.mProcessingBinding = binding;
-			binding->Deinit();
+			bindingGroupPair.second.ForEach([](ComboBinding* binding) {
+				binding->Deinit();
+			});
 		}
-		bindingPack.mButtonDownBindings.mProcessingBinding = nullptr;
+		player.mComboBindings.clear();
+		player.mComboPartials.clear();
+		player.mComboPressTimes.clear();
 	}
-
-
+	mComboDefinitions.clear();
+	mComboNodes.clear();
+	mComboEdges.clear();
+	mComboChordButtons.clear();
+	mCombosDirty = false;
 
 	for (auto forwarder : mForwarders)
 	{
@@ -100,17 +151,90 @@ void Input::Deinit()
 	}
 	mForwarders.clear();
 
-	mButtonBindings.clear();
+	for (auto& bucketPair : mRepeatBuckets)
+	{
+		auto& bucket = bucketPair.second;
+		bucket.mRepeaters.ForEach([](InputRepeater* repeater) {
+			repeater->mInputSystem = nullptr;
+		});
+		bucket.mTimeout.Cancel();
+	}
+	mRepeatBuckets.clear();
+	mWaitingRepeaters.ForEach([](InputRepeater* repeater) {
+		repeater->mFirstPeriod.Cancel();
+		repeater->mInputSystem = nullptr;
+		repeater->mWaiting = repeater->mParked = false;
+	});
+	mWaitingRepeaters.Clear();
+
+	for (PlayerInput& player : mPlayers)
+	{
+		player.mButtonBindings.clear();
+		for (auto& table : player.mDispatchTables)
+		{
+			table = {};
+		}
+	}
 
 	mButtonMappings.clear();
 	mAxisMappings.clear();
 	mChildAxes.clear();
+	mVirtualAxes.clear();
+	mDispatchTablesDirty = false;
+
+	for (auto& devicePlayers : mDevicePlayers)
+	{
+		devicePlayers.clear();
+	}
+	mPlayerCount = 1;
+	mBindingPlayer = 0;
+
+	mBatchedEvents.clear();
+	mBatchedContinuousEvents.clear();
+
+	mPaused = false;
+	ClearPauseJournal();
+
+	mPostedEvents.Deinit();
 
 	mButtons.clear();
 	mAxes.clear();
 	mCombinedAxes.clear();
 
+	mButtonIndices.clear();
+	mAxisIndices.clear();
+	mCursorIndices.clear();
+	mControlHandles.clear();
+	mControlHandleAddresses.clear();
+	ResizeStates();
+
+	// The handler's registry refs are released so that a re-Init on the same Lua state doesn't leak them,
+	// which needs the scheduler's state to still be open.
+	if (mScheduler != nullptr)
+	{
+		ClearFrameHandler();
+	}
+	mFrameHandler = mFrameEventTables = LUA_NOREF;
+	mFrameEventTableCount = 0;
+	mFrameEvents.clear();
+	mFlushedSinceSwap = false;
+	mButtonHandles.clear();
+	mAxisHandles.clear();
+	mCursorHandles.clear();
+
+	mContexts.clear();
+	mContextIndices.clear();
+	mContextStack.clear();
+	mActiveContexts = ~0ull;
+	mBindingContext = 0;
+
+	mEventTimestamp = {};
+	mFrameLatency = {};
+	mLastFrameLatency = {};
+	KENGINE_INPUT_INSTRUMENT(mPendingLuaResumes.clear());
+
 	mTimer = nullptr;
+	mLogger = nullptr;
 }
 
 void Input::AddCombinedAxis(KEngineCore::StringHash name)
@@ -126,9 +250,9 @@ void Input::AddChildAxis(KEngineCore::StringHash parentName, KEngineCore::String
 
 void Input::AddAxis(KEngineCore::StringHash name, ControllerType controllerType, int id)
 {
-	mAxes.insert(name);
-	mAxisMappings[{ controllerType, id }] = name;
-	mAxisBindings[name] =  {};
+	RegisterAxis(name, controllerType, id);
+	ResizeStates();
+	RefreshControlHandle(name);
 }
 
 void Input::AddAxisButton(KEngineCore::StringHash axisName, KEngineCore::StringHash name, AxisType axisType, int direction, ControllerType controllerType, int id)
@@ -139,208 +263,386 @@ void Input::AddAxisButton(KEngineCore::StringHash axisName, KEngineCore::StringH
 
 void Input::AddButton(KEngineCore::StringHash name, ControllerType controllerType, int id)
 {
-	mButtons.insert(name);
-	mButtonMappings[{ controllerType, id }] = name;
-	mButtonBindings[name] = {};
+	RegisterButton(name, controllerType, id);
+	ResizeStates();
+	RefreshControlHandle(name);
 }
 
 void KEngineBasics::Input::AddCursor(KEngineCore::StringHash name, ControllerType controllerType)
 {
-	mCursors.insert(name);
-	mCursorMappings[controllerType] = name;
-	mCursorPositionBindings[name] = {};
+	RegisterCursor(name, controllerType);
+	ResizeStates();
+	RefreshControlHandle(name);
 }
 
 void KEngineBasics::Input::AddVirtualAxis(KEngineCore::StringHash axisName, KEngineCore::StringHash convertedCursorName, AxisType axisType, KEngineCore::StringHash buttonName, float conversionFactor)
 {
-	assert(HasCursor(convertedCursorName));
-	assert(HasButton(buttonName));
-	mVirtualAxes[axisName] = { convertedCursorName, buttonName, axisType, conversionFactor };
+	RegisterVirtualAxis(axisName, { convertedCursorName, buttonName, axisType, conversionFactor });
+}
+
+// The whole table is registered before states are resized and handles refreshed, once each, and every name
+// is hashed once however many records refer to it.
+void KEngineBasics::Input::AddMappings(const InputMapping& mapping)
+{
+	using namespace InputMappingFormat;
+	std::map<uint32_t, KEngineCore::StringHash> names;
+	auto name = [&](uint32_t offset) {
+		auto it = names.find(offset);
+		if (it == names.end())
+		{
+			it = names.emplace(offset, KEngineCore::StringHash(mapping.GetString(offset))).first;
+		}
+		return it->second;
+	};
+
+	for (const Record& record : mapping.GetRecords())
+	{
+		ControllerType controllerType = (ControllerType)record.mControllerType;
+		switch (record.mKind)
+		{
+		case ButtonRecord:
+			RegisterButton(name(record.mName), controllerType, record.mId);
+			break;
+		case AxisRecord:
+			RegisterAxis(name(record.mName), controllerType, record.mId);
+			break;
+		case CursorRecord:
+			RegisterCursor(name(record.mName), controllerType);
+			break;
+		case CombinedAxisRecord:
+			mCombinedAxes.insert(name(record.mName));
+			break;
+		case ChildAxisRecord:
+			RegisterAxis(name(record.mName), controllerType, record.mId);
+			mChildAxes[{ name(record.mParent), (AxisType)record.mAxisType }] = name(record.mName);
+			break;
+		case AxisButtonRecord:
+			RegisterButton(name(record.mName), controllerType, record.mId);
+			mAxisButtons[{ name(record.mParent), record.mDirection }] = name(record.mName);
+			break;
+		case VirtualAxisRecord:
+			RegisterVirtualAxis(name(record.mName), { name(record.mParent), name(record.mButton), (AxisType)record.mAxisType, record.mConversionRate });
+			break;
+		}
+	}
+
+	ResizeStates();
+	for (auto& [handleName, handle] : mControlHandles)
+	{
+		RefreshControlHandle(handleName);
+	}
+}
+
+void KEngineBasics::Input::AddCombo(KEngineCore::StringHash name, std::span<const ComboStep> steps)
+{
+	assert(!steps.empty());
+	for (const ComboStep& step : steps)
+	{
+		assert(!step.mButtons.empty());
+		for (KEngineCore::StringHash buttonName : step.mButtons)
+		{
+			assert(HasButton(buttonName));
+		}
+	}
+	mComboDefinitions.push_back({ name, std::vector<ComboStep>(steps.begin(), steps.end()) });
+	for (PlayerInput& player : mPlayers)
+	{
+		player.mComboBindings.try_emplace(name);
+	}
+	mCombosDirty = true;
+}
+
+void KEngineBasics::Input::SetComboChordWindow(float seconds)
+{
+	mComboChordWindow = seconds;
+}
+
+void KEngineBasics::Input::SetAxisProcessing(KEngineCore::StringHash axisName, const AxisProcessing& processing)
+{
+	assert(processing.mDeadZone >= 0.0f && processing.mDeadZone < 1.0f);
+	assert(processing.mExponent > 0.0f);
+	assert(processing.mSmoothing >= 0.0f && processing.mSmoothing < 1.0f);
+	if (HasCombinedAxis(axisName))
+	{
+		ControlIndex horizontal = HasChildAxis(axisName, Horizontal) ? GetAxisIndex(GetAxisForCombinedAxis(axisName, Horizontal)) : InvalidControlIndex;
+		ControlIndex vertical = HasChildAxis(axisName, Vertical) ? GetAxisIndex(GetAxisForCombinedAxis(axisName, Vertical)) : InvalidControlIndex;
+		SetAxisConditioning(horizontal, processing, processing.mRadial ? vertical : InvalidControlIndex);
+		SetAxisConditioning(vertical, processing, processing.mRadial ? horizontal : InvalidControlIndex);
+	}
+	else
+	{
+		assert(HasAxis(axisName));
+		SetAxisConditioning(GetAxisIndex(axisName), processing, InvalidControlIndex);
+	}
+}
+
+void KEngineBasics::Input::SetAxisConditioning(ControlIndex axis, const AxisProcessing& processing, ControlIndex partner)
+{
+	if (axis != InvalidControlIndex)
+	{
+		mAxisConditioning[axis] = { processing.mDeadZone, processing.mExponent, processing.mInverted ? -1.0f : 1.0f, processing.mSmoothing, partner, true };
+	}
+}
+
+void KEngineBasics::Input::AddContext(KEngineCore::StringHash name, bool blocking)
+{
+	assert(!HasContext(name));
+	assert(mContexts.size() < MaxInputContexts);
+	mContextIndices[name] = (uint32_t)mContexts.size();
+	mContexts.push_back({ name, blocking, true });
+}
+
+bool KEngineBasics::Input::HasContext(KEngineCore::StringHash name) const
+{
+	return GetContextIndex(name) != UINT32_MAX;
+}
+
+void KEngineBasics::Input::PushContext(KEngineCore::StringHash name)
+{
+	uint32_t context = GetContextIndex(name);
+	assert(context != UINT32_MAX);
+	assert(std::find(mContextStack.begin(), mContextStack.end(), context) == mContextStack.end());
+	mContextStack.push_back(context);
+	UpdateActiveContexts();
+}
+
+// Contexts need not be popped in the order they were pushed, so a dialog can close underneath a tooltip.
+void KEngineBasics::Input::PopContext(KEngineCore::StringHash name)
+{
+	uint32_t context = GetContextIndex(name);
+	assert(context != 0);
+	auto it = std::find(mContextStack.begin(), mContextStack.end(), context);
+	if (it != mContextStack.end())
+	{
+		mContextStack.erase(it);
+		UpdateActiveContexts();
+	}
+}
+
+void KEngineBasics::Input::SetContextEnabled(KEngineCore::StringHash name, bool enabled)
+{
+	uint32_t context = GetContextIndex(name);
+	assert(context != UINT32_MAX);
+	mContexts[context].mEnabled = enabled;
+	UpdateActiveContexts();
+}
+
+bool KEngineBasics::Input::IsContextActive(KEngineCore::StringHash name) const
+{
+	uint32_t context = GetContextIndex(name);
+	return context != UINT32_MAX && (mActiveContexts & (1ull << context)) != 0;
+}
+
+void KEngineBasics::Input::SetBindingContext(KEngineCore::StringHash name)
+{
+	uint32_t context = GetContextIndex(name);
+	assert(context != UINT32_MAX);
+	mBindingContext = context;
+}
+
+KEngineCore::StringHash KEngineBasics::Input::GetBindingContext() const
+{
+	return mContexts[mBindingContext].mName;
+}
+
+void KEngineBasics::Input::AssignDevice(ControllerType controllerType, int device, int player)
+{
+	assert(device >= 0);
+	assert(player >= 0 && player < MaxPlayers);
+	std::vector<uint8_t>& devicePlayers = mDevicePlayers[controllerType];
+	if ((size_t)device >= devicePlayers.size())
+	{
+		devicePlayers.resize(device + 1, 0);
+	}
+	devicePlayers[device] = (uint8_t)player;
+	UsePlayer(player);
+}
+
+int KEngineBasics::Input::GetDevicePlayer(ControllerType controllerType, int device) const
+{
+	const std::vector<uint8_t>& devicePlayers = mDevicePlayers[controllerType];
+	return (device >= 0 && (size_t)device < devicePlayers.size()) ? devicePlayers[device] : 0;
+}
+
+void KEngineBasics::Input::SetBindingPlayer(int player)
+{
+	assert(player >= 0 && player < MaxPlayers);
+	mBindingPlayer = player;
+	UsePlayer(player);
+}
+
+int KEngineBasics::Input::GetBindingPlayer() const
+{
+	return mBindingPlayer;
+}
+
+int KEngineBasics::Input::GetEventDevice() const
+{
+	return mEventDevice;
+}
+
+std::chrono::steady_clock::time_point KEngineBasics::Input::GetEventTimestamp() const
+{
+	return mEventTimestamp;
+}
+
+void KEngineBasics::Input::UsePlayer(int player)
+{
+	if (player >= mPlayerCount)
+	{
+		mPlayerCount = player + 1;
+		mDispatchTablesDirty = true;
+	}
+}
+
+uint32_t KEngineBasics::Input::GetContextIndex(KEngineCore::StringHash name) const
+{
+	auto it = mContextIndices.find(name);
+	return it != mContextIndices.end() ? it->second : UINT32_MAX;
+}
+
+// Walks the stack from the top down, stopping after the first enabled blocking context.
+void KEngineBasics::Input::UpdateActiveContexts()
+{
+	mActiveContexts = 0;
+	for (auto it = mContextStack.rbegin(); it != mContextStack.rend(); ++it)
+	{
+		const InputContextDescription& context = mContexts[*it];
+		if (context.mEnabled)
+		{
+			mActiveContexts |= 1ull << *it;
+			if (context.mBlocking)
+			{
+				break;
+			}
+		}
+	}
+	UnparkRepeaters();
 }
 
 
 void Input::AddCombinedAxisBinding(CombinedAxisBinding* binding)
 {
 	assert(HasCombinedAxis(binding->GetControlName()));
-	mCombinedAxisBindings.mBindings.push_back(binding);
-	binding->SetPosition(std::next(mCombinedAxisBindings.mBindings.rbegin()).base());
+	binding->SetPosition(mCombinedAxisBindings.Add(binding, GetBindingContextMask()));
 }
 
 void Input::AddAxisBinding(AxisBinding* binding)
 {
 	assert(HasAxis(binding->GetAxisName()));
-	auto& bindingGroup = GetAxisBindings(binding->GetAxisName());
-	bindingGroup.mBindings.push_back(binding);
-	binding->SetPosition(std::next(bindingGroup.mBindings.rbegin()).base());
+	auto& bindingGroup = GetAxisBindings(mPlayers[mBindingPlayer], binding->GetAxisName());
+	binding->SetPosition(bindingGroup.Add(binding, GetBindingContextMask(), mBindingPlayer));
 }
 
 void KEngineBasics::Input::AddVirtualAxisBinding(VirtualAxisBinding* binding)
 {
 	assert(HasVirtualAxis(binding->GetControlName()));
-	mVirtualAxisBindings.mBindings.push_back(binding);
-	binding->SetPosition(std::next(mVirtualAxisBindings.mBindings.rbegin()).base());
+	auto& bindingGroup = mPlayers[mBindingPlayer].mVirtualAxes.find(binding->GetControlName())->second.mBindings;
+	binding->SetPosition(bindingGroup.Add(binding, GetBindingContextMask(), mBindingPlayer));
 }
 
 void Input::AddButtonDownBinding(ButtonDownBinding* binding)
 {
 	assert(HasButton(binding->GetButtonName()));
-	auto& bindingGroup = GetButtonBindings(binding->GetButtonName()).mButtonDownBindings;
-	bindingGroup.mBindings.push_back(binding);
-	binding->SetPosition(std::next(bindingGroup.mBindings.rbegin()).base());
+	auto& bindingGroup = GetButtonBindings(mPlayers[mBindingPlayer], binding->GetButtonName()).mButtonDownBindings;
+	binding->SetPosition(bindingGroup.Add(binding, GetBindingContextMask(), mBindingPlayer));
 }
 
 void Input::AddButtonUpBinding(ButtonUpBinding* binding)
 {
 	assert(HasButton(binding->GetButtonName()));
-	auto& bindingGroup = GetButtonBindings(binding->GetButtonName()).mButtonUpBindings;
-	bindingGroup.mBindings.push_back(binding);
-	binding->SetPosition(std::next(bindingGroup.mBindings.rbegin()).base());
+	auto& bindingGroup = GetButtonBindings(mPlayers[mBindingPlayer], binding->GetButtonName()).mButtonUpBindings;
+	binding->SetPosition(bindingGroup.Add(binding, GetBindingContextMask(), mBindingPlayer));
 }
 
 
 void Input::AddButtonHoldBinding(ButtonHoldBinding* binding)
 {
 	assert(HasButton(binding->GetButtonName()));
-	auto& bindingGroup = GetButtonBindings(binding->GetButtonName()).mButtonHoldBindings;
-	bindingGroup.mBindings.push_back(binding);
-	binding->SetPosition(std::next(bindingGroup.mBindings.rbegin()).base());
+	auto& bindingGroup = GetButtonBindings(mPlayers[mBindingPlayer], binding->GetButtonName()).mButtonHoldBindings;
+	binding->SetPosition(bindingGroup.Add(binding, GetBindingContextMask(), mBindingPlayer));
 }
 
 void KEngineBasics::Input::AddCursorPositionBinding(CursorPositionBinding* binding)
 {
 	assert(HasCursor(binding->GetControlName()));
-	auto& bindingGroup = mCursorPositionBindings[binding->GetControlName()];
-	bindingGroup.mBindings.push_back(binding);
-	binding->SetPosition(std::next(bindingGroup.mBindings.rbegin()).base());
+	CursorChannel& channel = GetCursorChannel(mPlayers[mBindingPlayer], binding->GetControlName());
+	auto& bindingGroup = binding->GetDelivery() == CursorDeliverEachEvent ? channel.mEachEventBindings : channel.mPerFrameBindings;
+	binding->SetPosition(bindingGroup.Add(binding, GetBindingContextMask(), mBindingPlayer));
+	if (binding->GetDelivery() == CursorDeliverPerFrameWithHistory)
+	{
+		channel.mHistoryBindingCount++;
+	}
 }
 
 bool Input::RemoveCombinedAxisBinding(CombinedAxisBinding* binding)
 {
-	if (mCombinedAxisBindings.mBindings.end() != binding->GetPosition())
-	{
-		if (mCombinedAxisBindings.mProcessingBinding == binding)
-		{
-			mCombinedAxisBindings.mSelfClearedBindings.push_back(binding);
-		}
-		else
-		{
-			mCombinedAxisBindings.mBindings.erase(binding->GetPosition());
-		}
-		return true;
-	}
-	return false;
+	return mCombinedAxisBindings.Remove(binding->GetPosition());
 }
 
 bool Input::RemoveAxisBinding(AxisBinding* binding)
 {
 	assert(HasAxis(binding->GetAxisName()));
-	auto& bindingGroup = GetAxisBindings(binding->GetAxisName());
-	if (bindingGroup.mBindings.end() != binding->GetPosition())
-	{
-		if (bindingGroup.mProcessingBinding == binding)
-		{
-			bindingGroup.mSelfClearedBindings.push_back(binding);
-		}
-		else
-		{
-			bindingGroup.mBindings.erase(binding->GetPosition());
-		}
-		return true;
-	}
-	return false;
+	auto& bindingGroup = GetAxisBindings(mPlayers[binding->GetPosition().mPlayer], binding->GetAxisName());
+	return bindingGroup.Remove(binding->GetPosition());
 }
 
 bool KEngineBasics::Input::RemoveVirtualAxisBinding(VirtualAxisBinding* binding)
 {
-	if (mVirtualAxisBindings.mBindings.end() != binding->GetPosition())
-	{
-		if (mVirtualAxisBindings.mProcessingBinding == binding)
-		{
-			mVirtualAxisBindings.mSelfClearedBindings.push_back(binding);
-		}
-		else
-		{
-			mVirtualAxisBindings.mBindings.erase(binding->GetPosition());
-		}
-		return true;
-	}
-	return false;
+	assert(HasVirtualAxis(binding->GetControlName()));
+	auto& bindingGroup = mPlayers[binding->GetPosition().mPlayer].mVirtualAxes.find(binding->GetControlName())->second.mBindings;
+	return bindingGroup.Remove(binding->GetPosition());
 }
 
 bool Input::RemoveButtonDownBinding(ButtonDownBinding* binding)
 {
 	assert(HasButton(binding->GetButtonName()));
-	auto& bindingGroup = GetButtonBindings(binding->GetButtonName()).mButtonDownBindings;
-	if (bindingGroup.mBindings.end() != binding->GetPosition())
-	{
-		if (bindingGroup.mProcessingBinding == binding)
-		{
-			bindingGroup.mSelfClearedBindings.push_back(binding);
-		}
-		else
-		{
-			bindingGroup.mBindings.erase(binding->GetPosition());
-		}
-		return true;
-	}
-	return false;
+	auto& bindingGroup = GetButtonBindings(mPlayers[binding->GetPosition().mPlayer], binding->GetButtonName()).mButtonDownBindings;
+	return bindingGroup.Remove(binding->GetPosition());
 }
 
 bool Input::RemoveButtonHoldBinding(ButtonHoldBinding* binding)
 {
 	assert(HasButton(binding->GetButtonName()));
-	auto& bindingGroup = GetButtonBindings(binding->GetButtonName()).mButtonHoldBindings;
-	if (bindingGroup.mBindings.end() != binding->GetPosition())
-	{
-		if (bindingGroup.mProcessingBinding == binding)
-		{
-			bindingGroup.mSelfClearedBindings.push_back(binding);
-		}
-		else
-		{
-			bindingGroup.mBindings.erase(binding->GetPosition());
-		}
-		return true;
-	}
-	return false;
+	auto& bindingGroup = GetButtonBindings(mPlayers[binding->GetPosition().mPlayer], binding->GetButtonName()).mButtonHoldBindings;
+	return bindingGroup.Remove(binding->GetPosition());
 }
 
 bool KEngineBasics::Input::RemoveCursorPositionBinding(CursorPositionBinding* binding)
 {
 	assert(HasCursor(binding->GetControlName()));
-	auto& bindingGroup = mCursorPositionBindings[binding->GetControlName()];
-	if (bindingGroup.mBindings.end() != binding->GetPosition())
+	CursorChannel& channel = GetCursorChannel(mPlayers[binding->GetPosition().mPlayer], binding->GetControlName());
+	auto& bindingGroup = binding->GetDelivery() == CursorDeliverEachEvent ? channel.mEachEventBindings : channel.mPerFrameBindings;
+	if (!bindingGroup.Remove(binding->GetPosition()))
 	{
-		if (bindingGroup.mProcessingBinding == binding)
-		{
-			bindingGroup.mSelfClearedBindings.push_back(binding);
-		}
-		else
-		{
-			bindingGroup.mBindings.erase(binding->GetPosition());
-		}
-		return true;
+		return false;
+	}
+	if (binding->GetDelivery() == CursorDeliverPerFrameWithHistory && --channel.mHistoryBindingCount == 0)
+	{
+		channel.mSamples.clear();
 	}
-	return false;
+	return true;
+}
+
+void KEngineBasics::Input::AddComboBinding(ComboBinding* binding)
+{
+	assert(HasCombo(binding->GetComboName()));
+	auto& bindingGroup = mPlayers[mBindingPlayer].mComboBindings.find(binding->GetComboName())->second;
+	binding->SetPosition(bindingGroup.Add(binding, GetBindingContextMask(), mBindingPlayer));
+}
+
+bool KEngineBasics::Input::RemoveComboBinding(ComboBinding* binding)
+{
+	assert(HasCombo(binding->GetComboName()));
+	auto& bindingGroup = mPlayers[binding->GetPosition().mPlayer].mComboBindings.find(binding->GetComboName())->second;
+	return bindingGroup.Remove(binding->GetPosition());
 }
 
 bool Input::RemoveButtonUpBinding(ButtonUpBinding* binding)
 {
 	assert(HasButton(binding->GetButtonName()));
-	auto& bindingGroup = GetButtonBindings(binding->GetButtonName()).mButtonUpBindings;
-	if (bindingGroup.mBindings.end() != binding->GetPosition())
-	{
-		if (bindingGroup.mProcessingBinding == binding)
-		{
-			bindingGroup.mSelfClearedBindings.push_back(binding);
-		}
-		else
-		{
-			bindingGroup.mBindings.erase(binding->GetPosition());
-		}
-		return true;
-	}
-	return false;
+	auto& bindingGroup = GetButtonBindings(mPlayers[binding->GetPosition().mPlayer], binding->GetButtonName()).mButtonUpBindings;
+	return bindingGroup.Remove(binding->GetPosition());
 }
 
 
@@ -353,7 +655,7 @@ ButtonDownBinding::~ButtonDownBinding()
 	Deinit();
 }
 
-void ButtonDownBinding::Init(Input* inputSystem, KEngineCore::StringHash buttonName, std::function<void()> callback, std::function<void()> cancelCallback, bool oneShot)
+void ButtonDownBinding::Init(Input* inputSystem, KEngineCore::StringHash buttonName, InlineFunction<void()> callback, InlineFunction<void()> cancelCallback, bool oneShot)
 {
 	assert(mInputSystem == nullptr);
 	mInputSystem = inputSystem;
@@ -415,7 +717,7 @@ ButtonUpBinding::~ButtonUpBinding()
 	Deinit();
 }
 
-void ButtonUpBinding::Init(Input* inputSystem, KEngineCore::StringHash buttonName, std::function<void()> callback, std::function<void()> cancelCallback)
+void ButtonUpBinding::Init(Input* inputSystem, KEngineCore::StringHash buttonName, InlineFunction<void()> callback, InlineFunction<void()> cancelCallback)
 {
 	assert(mInputSystem == nullptr);
 	mInputSystem = inputSystem;
@@ -471,7 +773,7 @@ ButtonHoldBinding::~ButtonHoldBinding()
 	Deinit();
 }
 
-void ButtonHoldBinding::Init(Input* inputSystem, KEngineCore::Timer * timer, KEngineCore::StringHash buttonName, float frequency, std::function<void()> callback, std::function<void()> cancelCallback)
+void ButtonHoldBinding::Init(Input* inputSystem, KEngineCore::Timer * timer, KEngineCore::StringHash buttonName, float frequency, InlineFunction<void()> callback, InlineFunction<void()> cancelCallback)
 {
 	assert(mInputSystem == nullptr);
 	mInputSystem = inputSystem;
@@ -520,7 +822,7 @@ void KEngineBasics::ButtonHoldBinding::ButtonDown()
  	if (mButtonIsReady)
 	{
 		Fire();
-		mTimeout.Init(mTimer, 1.0 / mFrequency, true, [this]() {
+		mRepeater.Init(mInputSystem, mTimer, mFrequency, [this]() {
 			if (mButtonIsDown)
 			{
 				Fire();
@@ -528,7 +830,7 @@ void KEngineBasics::ButtonHoldBinding::ButtonDown()
 			else
 			{
 				mButtonIsReady = true;
-				mTimeout.Cancel();
+				mRepeater.Cancel();
 			}
 		});
 	}
@@ -551,7 +853,7 @@ void ButtonHoldBinding::Cancel()
 {
 	if (mInputSystem != nullptr)
 	{
-		mTimeout.Cancel();
+		mRepeater.Cancel();
 		if (mInputSystem->RemoveButtonHoldBinding(this) && mCancelCallback) {
 			mCancelCallback();
 		}
@@ -569,7 +871,7 @@ AxisBinding::~AxisBinding()
 }
 
 
-void AxisBinding::Init(Input* inputSystem, KEngineCore::Timer* timer, KEngineCore::StringHash controlName, float deadZone, float frequency, std::function<void(float)> callback, std::function<void()> cancelCallback)
+void AxisBinding::Init(Input* inputSystem, KEngineCore::Timer* timer, KEngineCore::StringHash controlName, float deadZone, float frequency, InlineFunction<void(float)> callback, InlineFunction<void()> cancelCallback)
 {
 	assert(mInputSystem == nullptr);
 	mInputSystem = inputSystem;
@@ -643,17 +945,20 @@ KEngineCore::StringHash KEngineBasics::AxisBinding::GetAxisName() const
 void AxisBinding::UpdateAxis(float tilt)
 {
 	mLastTilt = tilt;
-	if (mDead && (mLastTilt >= mDeadZone || mLastTilt <= -mDeadZone))
+	if (mFrequency <= 0.0f)
+	{
+		Fire(mLastTilt);
+	}
+	else if (mDead && (mLastTilt >= mDeadZone || mLastTilt <= -mDeadZone))
 	{
-		mLastTilt = tilt;
 		mDead = false;
 		Fire(mLastTilt);
-		mTimeout.Init(mTimer, 1.0 / mFrequency, true, [this]() {
+		mRepeater.Init(mInputSystem, mTimer, mFrequency, [this]() {
 			if (mLastTilt < mDeadZone && mLastTilt > -mDeadZone)
 			{
 				mDead = true;
 				Fire(0.0f);
-				mTimeout.Cancel();
+				mRepeater.Cancel();
 			}
 			else {
 				Fire(mLastTilt);
@@ -672,7 +977,7 @@ void AxisBinding::Cancel()
 {
 	if (mInputSystem != nullptr)
 	{
-		mTimeout.Cancel();
+		mRepeater.Cancel();
 		if (mInputSystem->RemoveAxisBinding(this) && mCancelCallback) {
 			mCancelCallback();
 		}
@@ -689,7 +994,7 @@ KEngineBasics::CursorPositionBinding::~CursorPositionBinding()
 	Deinit();
 }
 
-void KEngineBasics::CursorPositionBinding::Init(Input* inputSystem, KEngineCore::StringHash controlName, std::function<void(const KEngine2D::Point&)> callback, std::function<void()> cancelCallback)
+void KEngineBasics::CursorPositionBinding::Init(Input* inputSystem, KEngineCore::StringHash controlName, InlineFunction<void(const KEngine2D::Point&)> callback, InlineFunction<void()> cancelCallback, CursorDelivery delivery)
 {
 	assert(mInputSystem == nullptr);
 	assert(inputSystem->HasCursor(controlName));
@@ -697,6 +1002,7 @@ void KEngineBasics::CursorPositionBinding::Init(Input* inputSystem, KEngineCore:
 	mControlName = controlName;
 	mCallback = callback;
 	mCancelCallback = cancelCallback;
+	mDelivery = delivery;
 	inputSystem->AddCursorPositionBinding(this);
 }
 
@@ -720,17 +1026,34 @@ KEngineCore::StringHash KEngineBasics::CursorPositionBinding::GetControlName() c
 	return mControlName;
 }
 
-void KEngineBasics::CursorPositionBinding::UpdateCursor(const KEngine2D::Point& point)
+KEngineBasics::CursorDelivery KEngineBasics::CursorPositionBinding::GetDelivery() const
 {
-	Fire(point);
+	return mDelivery;
 }
 
-void KEngineBasics::CursorPositionBinding::Fire(const KEngine2D::Point& point)
+std::span<const KEngineBasics::CursorSample> KEngineBasics::CursorPositionBinding::GetSamples() const
 {
-	if (mCallback)
-	{
-		mCallback(point);
-	}
+	assert(mInputSystem != nullptr);
+	return mInputSystem->GetCursorSamples(mControlName, mPosition.mPlayer);
+}
+
+KEngine2D::Point KEngineBasics::CursorPositionBinding::GetDelta() const
+{
+	assert(mInputSystem != nullptr);
+	return mInputSystem->GetCursorDelta(mControlName, mPosition.mPlayer);
+}
+
+void KEngineBasics::CursorPositionBinding::UpdateCursor(const KEngine2D::Point& point)
+{
+	Fire(point);
+}
+
+void KEngineBasics::CursorPositionBinding::Fire(const KEngine2D::Point& point)
+{
+	if (mCallback)
+	{
+		mCallback(point);
+	}
 }
 
 void KEngineBasics::CursorPositionBinding::Cancel()
@@ -756,7 +1079,7 @@ KEngineBasics::VirtualAxisBinding::~VirtualAxisBinding()
 	Deinit();
 }
 
-void KEngineBasics::VirtualAxisBinding::Init(Input* inputSystem, KEngineCore::StringHash controlName, std::function<void(float)> callback, std::function<void()> cancelCallback)
+void KEngineBasics::VirtualAxisBinding::Init(Input* inputSystem, KEngineCore::StringHash controlName, InlineFunction<void(float)> callback, InlineFunction<void()> cancelCallback)
 {
 	assert(mInputSystem == nullptr);
 	assert(inputSystem->HasVirtualAxis(controlName));
@@ -765,37 +1088,6 @@ void KEngineBasics::VirtualAxisBinding::Init(Input* inputSystem, KEngineCore::St
 	mCallback = callback;
 	mCancelCallback = cancelCallback;
 	inputSystem->AddVirtualAxisBinding(this);
-	mDescription = inputSystem->GetVirtualAxisDescription(controlName);
-	assert(inputSystem->HasCursor(mDescription.mConvertedCursor));
-	assert(inputSystem->HasButton(mDescription.mConvertingButton));
-
-	mCursorPositionChanged.Init(inputSystem, mDescription.mConvertedCursor, [this](const KEngine2D::Point& position) {
-		switch (mDescription.mAxisType)
-		{
-		case AxisType::Horizontal:
-			mCurrentPosition = position.x;
-			break;
-		case AxisType::Vertical:
-			mCurrentPosition = position.y;
-			break;
-		}
-		if (mActive)
-		{
-			float diff = mCurrentPosition - mStartPosition;
-			float converted = std::clamp(diff * mDescription.mConversionRate, -1.0f, 1.0f);
-			mCallback(converted);
-		}
-	});
-
-	mConvertingDown.Init(inputSystem, mDescription.mConvertingButton, [this]() {
-		mStartPosition = mCurrentPosition;
-		mActive = true;
-	});
-
-	mConvertingUp.Init(inputSystem, mDescription.mConvertingButton, [this]() {
-		mCallback(0.0);
-		mActive = false;
-	});
 }
 
 void KEngineBasics::VirtualAxisBinding::Deinit()
@@ -837,6 +1129,62 @@ void KEngineBasics::VirtualAxisBinding::Cancel()
 }
 
 
+KEngineBasics::ComboBinding::ComboBinding()
+{
+}
+
+KEngineBasics::ComboBinding::~ComboBinding()
+{
+	Deinit();
+}
+
+void KEngineBasics::ComboBinding::Init(Input* inputSystem, KEngineCore::StringHash comboName, InlineFunction<void()> callback, InlineFunction<void()> cancelCallback)
+{
+	assert(mInputSystem == nullptr);
+	mInputSystem = inputSystem;
+	mComboName = comboName;
+	mCallback = callback;
+	mCancelCallback = cancelCallback;
+	inputSystem->AddComboBinding(this);
+}
+
+void KEngineBasics::ComboBinding::Deinit()
+{
+	Cancel();
+}
+
+void KEngineBasics::ComboBinding::SetPosition(Position position)
+{
+	mPosition = position;
+}
+
+KEngineBasics::ComboBinding::Position KEngineBasics::ComboBinding::GetPosition()
+{
+	return mPosition;
+}
+
+KEngineCore::StringHash KEngineBasics::ComboBinding::GetComboName() const
+{
+	return mComboName;
+}
+
+void KEngineBasics::ComboBinding::Fire()
+{
+	assert(mCallback);
+	mCallback();
+}
+
+void KEngineBasics::ComboBinding::Cancel()
+{
+	if (mInputSystem != nullptr)
+	{
+		if (mInputSystem->RemoveComboBinding(this) && mCancelCallback) {
+			mCancelCallback();
+		}
+		mInputSystem = nullptr;
+	}
+}
+
 KEngineBasics::CombinedAxisBinding::CombinedAxisBinding()
 {
 }
@@ -848,7 +1196,7 @@ CombinedAxisBinding::~CombinedAxisBinding()
 
 
 
-void CombinedAxisBinding::Init(Input* inputSystem, KEngineCore::Timer* timer, KEngineCore::StringHash controlName, float deadZone, float frequency, std::function<void(const KEngine2D::Point&)> callback, std::function<void()> cancelCallback)
+void CombinedAxisBinding::Init(Input* inputSystem, KEngineCore::Timer* timer, KEngineCore::StringHash controlName, float deadZone, float frequency, InlineFunction<void(const KEngine2D::Point&)> callback, InlineFunction<void()> cancelCallback)
 {
 	assert(mInputSystem == nullptr);
 	mInputSystem = inputSystem;
@@ -862,56 +1210,53 @@ void CombinedAxisBinding::Init(Input* inputSystem, KEngineCore::Timer* timer, KE
 	mDead = true;
 	mLastTilt = KEngine2D::Point::Origin();
 
+	// The child axes report every change (frequency zero) so that this binding runs the only repeater.
 	if (inputSystem->HasChildAxis(controlName, AxisType::Horizontal)) {
 		KEngineCore::StringHash horizontalName = inputSystem->GetAxisForCombinedAxis(controlName, AxisType::Horizontal);
-		mHorizontalAxisBinding.Init(inputSystem, timer, horizontalName, deadZone, frequency, [this](float tilt)
+		mHorizontalAxisBinding.Init(inputSystem, timer, horizontalName, deadZone, 0.0f, [this](float tilt)
 			{
 				mLastTilt.x = tilt;
-				if (mDead && (mLastTilt.x >= mDeadZone || mLastTilt.x <= -mDeadZone || mLastTilt.y >= mDeadZone || mLastTilt.y <= -mDeadZone))
-				{
-					mDead = false;
-					Fire(mLastTilt);
-					mTimeout.Init(mTimer, 1.0 / mFrequency, true, [this]() {
-						if (mLastTilt.x < mDeadZone && mLastTilt.x > -mDeadZone && mLastTilt.y < mDeadZone && mLastTilt.y > -mDeadZone)
-						{
-							mDead = true;
-							Fire({ 0.0, 0.0 });
-							mTimeout.Cancel();
-						}
-						else {
-							Fire(mLastTilt);
-						}
-					});
-				}
+				UpdateTilt();
 			}
 		);
 	}
 
 	if (inputSystem->HasChildAxis(controlName, AxisType::Vertical)) {
 		KEngineCore::StringHash verticalName = inputSystem->GetAxisForCombinedAxis(controlName, AxisType::Vertical);
-		mVerticalAxisBinding.Init(inputSystem, timer, verticalName, deadZone, frequency, [this](float tilt)
+		mVerticalAxisBinding.Init(inputSystem, timer, verticalName, deadZone, 0.0f, [this](float tilt)
 			{
 				mLastTilt.y = tilt;
-				if (mDead && (mLastTilt.x >= mDeadZone || mLastTilt.x <= -mDeadZone || mLastTilt.y >= mDeadZone || mLastTilt.y <= -mDeadZone))
-				{
-					mDead = false;
-					Fire(mLastTilt);
-					mTimeout.Init(mTimer, 1.0 / mFrequency, true, [this]() {
-						if (mLastTilt.x < mDeadZone && mLastTilt.x > -mDeadZone && mLastTilt.y < mDeadZone && mLastTilt.y > -mDeadZone)
-						{
-							mDead = true;
-							mTimeout.Cancel();
-						}
-						else {
-							Fire(mLastTilt);
-						}
-					});
-				}
+				UpdateTilt();
 			}
 		);
 	}
 }
 
+void CombinedAxisBinding::UpdateTilt()
+{
+	if (mDead && !IsInDeadZone())
+	{
+		mDead = false;
+		Fire(mLastTilt);
+		mRepeater.Init(mInputSystem, mTimer, mFrequency, [this]() {
+			if (IsInDeadZone())
+			{
+				mDead = true;
+				Fire({ 0.0, 0.0 });
+				mRepeater.Cancel();
+			}
+			else {
+				Fire(mLastTilt);
+			}
+		});
+	}
+}
+
+bool CombinedAxisBinding::IsInDeadZone() const
+{
+	return mLastTilt.x < mDeadZone && mLastTilt.x > -mDeadZone && mLastTilt.y < mDeadZone && mLastTilt.y > -mDeadZone;
+}
+
 void CombinedAxisBinding::Deinit()
 {
 	Cancel();
@@ -942,7 +1287,7 @@ void CombinedAxisBinding::Cancel()
 {
 	if (mInputSystem != nullptr)
 	{
-		mTimeout.Cancel();
+		mRepeater.Cancel();
 		if (mInputSystem->RemoveCombinedAxisBinding(this) && mCancelCallback) {
 			mCancelCallback();
 		}
@@ -950,142 +1295,407 @@ void CombinedAxisBinding::Cancel()
 	mInputSystem = nullptr;
 }
 
-void KEngineBasics::Input::HandleAxisChange(ControllerType type, int axisId, float axisPosition)
+void KEngineBasics::Input::HandleAxisChange(ControllerType type, int axisId, float axisPosition, int device, std::chrono::steady_clock::time_point timestamp)
 {
+	timestamp = StampIngestion(timestamp);
 	if (mPaused)
 	{
-		mQueuedAxisUpdates[{type, axisId}] = axisPosition;
+		JournalEvent({ AxisChangeEvent, type, axisId, axisPosition, { 0.0, 0.0 }, device, timestamp });
 	}
 	else
 	{
-		if (HasAxisMapping(type, axisId))
+		PlayerInput& player = GetEventPlayer(type, device);
+		const ControlDispatch* control = GetDispatchTable(player, type).Find(axisId);
+		float processedPosition = axisPosition;
+		if (control != nullptr && control->mAxisIndex != InvalidControlIndex)
 		{
-			KEngineCore::StringHash axisName = GetAxisMapping(type, axisId);
-			auto& bindingGroup = GetAxisBindings(axisName);
-			for (AxisBinding* binding : bindingGroup.mBindings)
-			{
-				bindingGroup.mProcessingBinding = binding;
-				binding->UpdateAxis(axisPosition);
-			}
-			bindingGroup.mProcessingBinding = nullptr;
-			bindingGroup.Cleanup();
+			processedPosition = ProcessAxis(player, control->mAxisIndex, axisPosition);
 		}
+		DispatchAxisChange(player, control, type, axisId, axisPosition, processedPosition, device, timestamp);
+	}
+}
 
-		for (auto forwarder : mForwarders)
-		{
-			forwarder->HandleAxisChange(type, axisId, axisPosition);
-		}
+// State and bindings get the processed position, forwarders the raw one.
+void KEngineBasics::Input::DispatchAxisChange(PlayerInput& player, const ControlDispatch* control, ControllerType type, int axisId, float axisPosition, float processedPosition, int device, std::chrono::steady_clock::time_point timestamp)
+{
+	int eventDevice = std::exchange(mEventDevice, device);
+	std::chrono::steady_clock::time_point eventTimestamp = std::exchange(mEventTimestamp, timestamp);
+	KENGINE_INPUT_INSTRUMENT(uint64_t visitedBefore = BeginInstrumentedEvent(AxisChangeEvent, control != nullptr ? control->mAxisIndex : InvalidControlIndex));
+	if (control != nullptr && control->mAxisIndex != InvalidControlIndex)
+	{
+		GetBackState(player).mAxes[control->mAxisIndex] = processedPosition;
+		RecordFrameEvent(AxisChangeEvent, control->mAxisIndex, player, processedPosition);
+	}
+	if (control != nullptr && control->mAxisBindings != nullptr)
+	{
+		Dispatch(*control->mAxisBindings, [&](AxisBinding* binding) {
+			binding->UpdateAxis(processedPosition);
+		});
 	}
+
+	mEventDevice = device;
+	mEventTimestamp = timestamp;
+	for (auto forwarder : mForwarders)
+	{
+		forwarder->HandleAxisChange(type, axisId, axisPosition);
+	}
+	KENGINE_INPUT_INSTRUMENT(EndInstrumentedEvent(visitedBefore));
+	mEventDevice = eventDevice;
+	mEventTimestamp = eventTimestamp;
 }
 
-void KEngineBasics::Input::HandleButtonDown(ControllerType type, int buttonId)
+void KEngineBasics::Input::HandleButtonDown(ControllerType type, int buttonId, int device, std::chrono::steady_clock::time_point timestamp)
 {
+	timestamp = StampIngestion(timestamp);
 	if (mPaused)
 	{
-		if (mQueuedButtonUps.contains({ type, buttonId }))
-		{
-			mQueuedButtonUps.erase({ type, buttonId });
-		}
-		else
-		{
-			mQueuedButtonDowns.insert({ type, buttonId });
-		}
+		JournalEvent({ ButtonDownEvent, type, buttonId, 0.0f, { 0.0, 0.0 }, device, timestamp });
 	}
 	else {
-		HandleButonDownInternal(type, buttonId);
-		HandleButonDownInternal(type, -1);
+		int eventDevice = std::exchange(mEventDevice, device);
+		std::chrono::steady_clock::time_point eventTimestamp = std::exchange(mEventTimestamp, timestamp);
+		PlayerInput& player = GetEventPlayer(type, device);
+		const ControllerDispatchTable& table = GetDispatchTable(player, type);
+		const ControlDispatch* control = table.Find(buttonId);
+		// Callbacks may rebuild the dispatch tables, leaving control dangling, so it isn't read once they run.
+		ControlIndex buttonIndex = control != nullptr ? control->mButtonIndex : InvalidControlIndex;
+		KENGINE_INPUT_INSTRUMENT(uint64_t visitedBefore = BeginInstrumentedEvent(ButtonDownEvent, buttonIndex));
+		HandleButonDownInternal(player, control);
+		HandleButonDownInternal(player, table.Find(-1));
+		if (buttonIndex != InvalidControlIndex && !mComboDefinitions.empty())
+		{
+			AdvanceCombos(player, buttonIndex);
+		}
 
+		mEventDevice = device;
+		mEventTimestamp = timestamp;
 		for (auto forwarder : mForwarders)
 		{
 			forwarder->HandleButtonDown(type, buttonId);
 		}
+		KENGINE_INPUT_INSTRUMENT(EndInstrumentedEvent(visitedBefore));
+		mEventDevice = eventDevice;
+		mEventTimestamp = eventTimestamp;
 	}
 }
 
-void KEngineBasics::Input::HandleButonDownInternal(KEngineBasics::ControllerType type, int buttonId)
+void KEngineBasics::Input::HandleButonDownInternal(PlayerInput& player, const ControlDispatch* control)
 {
-	if (HasButtonMapping(type, buttonId))
+	if (control != nullptr && control->mButtonIndex != InvalidControlIndex)
 	{
-		KEngineCore::StringHash buttonName = GetButtonMapping(type, buttonId);
-		auto& bindingGroup = GetButtonBindings(buttonName).mButtonDownBindings;
-		for (ButtonDownBinding* binding : bindingGroup.mBindings)
-		{
-			bindingGroup.mProcessingBinding = binding;
+		GetBackState(player).SetButton(control->mButtonIndex, true);
+		RecordFrameEvent(ButtonDownEvent, control->mButtonIndex, player, 1.0f);
+	}
+	// The pack lives in the player's binding map, so unlike control it survives callbacks that rebuild the tables.
+	ButtonBindingPack* bindings = control != nullptr ? control->mButtonBindings : nullptr;
+	if (bindings != nullptr)
+	{
+		Dispatch(bindings->mButtonDownBindings, [&](ButtonDownBinding* binding) {
 			binding->Fire();
-		}
-		bindingGroup.mProcessingBinding = nullptr;
-		bindingGroup.Cleanup();
+		});
+		StartVirtualAxes(*bindings);
 	}
 }
 
 
-void KEngineBasics::Input::HandleButtonUp(ControllerType type, int buttonId)
+void KEngineBasics::Input::HandleButtonUp(ControllerType type, int buttonId, int device, std::chrono::steady_clock::time_point timestamp)
 {
+	timestamp = StampIngestion(timestamp);
 	if (mPaused)
 	{
-		if (mQueuedButtonDowns.contains({ type, buttonId }))
-		{
-			mQueuedButtonDowns.erase({ type, buttonId });
-		}
-		else
-		{
-			mQueuedButtonUps.insert({ type, buttonId });
-		}
+		JournalEvent({ ButtonUpEvent, type, buttonId, 0.0f, { 0.0, 0.0 }, device, timestamp });
 	}
 	else {
-		HandleButtonUpInternal(type, buttonId);
-		HandleButtonUpInternal(type, -1);
+		int eventDevice = std::exchange(mEventDevice, device);
+		std::chrono::steady_clock::time_point eventTimestamp = std::exchange(mEventTimestamp, timestamp);
+		PlayerInput& player = GetEventPlayer(type, device);
+		const ControllerDispatchTable& table = GetDispatchTable(player, type);
+		const ControlDispatch* control = table.Find(buttonId);
+		KENGINE_INPUT_INSTRUMENT(uint64_t visitedBefore = BeginInstrumentedEvent(ButtonUpEvent, control != nullptr ? control->mButtonIndex : InvalidControlIndex));
+		HandleButtonUpInternal(player, control);
+		HandleButtonUpInternal(player, table.Find(-1));
+		mEventDevice = device;
+		mEventTimestamp = timestamp;
 		for (auto forwarder : mForwarders)
 		{
 			forwarder->HandleButtonUp(type, buttonId);
 		}
+		KENGINE_INPUT_INSTRUMENT(EndInstrumentedEvent(visitedBefore));
+		mEventDevice = eventDevice;
+		mEventTimestamp = eventTimestamp;
 	}
 }
 
-void KEngineBasics::Input::HandleCursorPosition(ControllerType type, const KEngine2D::Point& position)
+void KEngineBasics::Input::HandleCursorPosition(ControllerType type, const KEngine2D::Point& position, int device, std::chrono::steady_clock::time_point timestamp)
 {
+	timestamp = StampIngestion(timestamp);
 	if (mPaused)
 	{
-		mQueuedCursorUpdates[type] = position;
+		JournalEvent({ CursorPositionEvent, type, 0, 0.0f, position, device, timestamp });
 	}
 	else
 	{
-		if (HasCursorMapping(type))
+		int eventDevice = std::exchange(mEventDevice, device);
+		std::chrono::steady_clock::time_point eventTimestamp = std::exchange(mEventTimestamp, timestamp);
+		PlayerInput& player = GetEventPlayer(type, device);
+		const ControllerDispatchTable& table = GetDispatchTable(player, type);
+		KENGINE_INPUT_INSTRUMENT(uint64_t visitedBefore = BeginInstrumentedEvent(CursorPositionEvent, table.mCursorIndex));
+		if (table.mCursorIndex != InvalidControlIndex)
 		{
-			KEngineCore::StringHash cursorName = GetCursorMapping(type);
-			auto& bindingGroup = GetCursorBindings(cursorName);
-			for (CursorPositionBinding* binding : bindingGroup.mBindings)
-			{
-				bindingGroup.mProcessingBinding = binding;
+			GetBackState(player).mCursors[table.mCursorIndex] = position;
+			RecordFrameEvent(CursorPositionEvent, table.mCursorIndex, player, 0.0f, position);
+		}
+		CursorChannel* channel = table.mCursorChannel;
+		if (channel != nullptr)
+		{
+			RecordCursorSample(*channel, position);
+			Dispatch(channel->mEachEventBindings, [&](CursorPositionBinding* binding) {
 				binding->UpdateCursor(position);
-			}
-			bindingGroup.mProcessingBinding = nullptr;
-			bindingGroup.Cleanup();
+			});
+			UpdateVirtualAxes(*channel, position);
 		}
 
+		mEventDevice = device;
+		mEventTimestamp = timestamp;
 		for (auto forwarder : mForwarders)
 		{
 			forwarder->HandleCursorPosition(type, position);
 		}
+		KENGINE_INPUT_INSTRUMENT(EndInstrumentedEvent(visitedBefore));
+		mEventDevice = eventDevice;
+		mEventTimestamp = eventTimestamp;
 	}
 }
 
-void KEngineBasics::Input::HandleButtonUpInternal(KEngineBasics::ControllerType type, int buttonId)
+void KEngineBasics::Input::HandleButtonUpInternal(PlayerInput& player, const ControlDispatch* control)
 {
-	if (HasButtonMapping(type, buttonId))
+	if (control != nullptr && control->mButtonIndex != InvalidControlIndex)
 	{
-		KEngineCore::StringHash buttonName = GetButtonMapping(type, buttonId); 
-		auto& bindingGroup = GetButtonBindings(buttonName).mButtonUpBindings;
-		for (ButtonUpBinding* binding : bindingGroup.mBindings)
-		{
-			bindingGroup.mProcessingBinding = binding;
+		GetBackState(player).SetButton(control->mButtonIndex, false);
+		RecordFrameEvent(ButtonUpEvent, control->mButtonIndex, player, 0.0f);
+	}
+	ButtonBindingPack* bindings = control != nullptr ? control->mButtonBindings : nullptr;
+	if (bindings != nullptr)
+	{
+		Dispatch(bindings->mButtonUpBindings, [&](ButtonUpBinding* binding) {
 			binding->Fire();
+		});
+		StopVirtualAxes(*bindings);
+	}
+}
+
+
+void KEngineBasics::Input::HandleEvent(const InputEvent& event)
+{
+	switch (event.mType)
+	{
+	case AxisChangeEvent:
+		HandleAxisChange(event.mControllerType, event.mId, event.mValue, event.mDevice, event.mTimestamp);
+		break;
+	case ButtonDownEvent:
+		HandleButtonDown(event.mControllerType, event.mId, event.mDevice, event.mTimestamp);
+		break;
+	case ButtonUpEvent:
+		HandleButtonUp(event.mControllerType, event.mId, event.mDevice, event.mTimestamp);
+		break;
+	case CursorPositionEvent:
+		HandleCursorPosition(event.mControllerType, event.mPosition, event.mDevice, event.mTimestamp);
+		break;
+	}
+}
+
+void KEngineBasics::Input::SubmitEvent(const InputEvent& submitted)
+{
+	InputEvent event = submitted;
+	event.mTimestamp = StampIngestion(submitted.mTimestamp);
+	if (event.mType == AxisChangeEvent || event.mType == CursorPositionEvent)
+	{
+		for (size_t& index : mBatchedContinuousEvents)
+		{
+			BatchedEvent& batched = mBatchedEvents[index];
+			if (batched.mEvent.mType == event.mType && batched.mEvent.mControllerType == event.mControllerType && batched.mEvent.mDevice == event.mDevice && (event.mType == CursorPositionEvent || batched.mEvent.mId == event.mId))
+			{
+				batched.mLive = false;
+				index = mBatchedEvents.size();
+				mBatchedEvents.push_back({ event, true });
+				return;
+			}
+		}
+		mBatchedContinuousEvents.push_back(mBatchedEvents.size());
+	}
+	mBatchedEvents.push_back({ event, true });
+}
+
+void KEngineBasics::Input::SubmitEvents(std::span<const InputEvent> events)
+{
+	for (const InputEvent& event : events)
+	{
+		SubmitEvent(event);
+	}
+}
+
+void KEngineBasics::Input::Flush()
+{
+	// Swap out the batch so that events submitted by callbacks during the flush wait for the next one.
+	std::swap(mBatchedEvents, mFlushingEvents);
+	mBatchedContinuousEvents.clear();
+	ProcessBatchedAxes();
+	for (const BatchedEvent& batched : mFlushingEvents)
+	{
+		if (batched.mLive && batched.mProcessed && !mPaused)
+		{
+			const InputEvent& event = batched.mEvent;
+			PlayerInput& player = GetEventPlayer(event.mControllerType, event.mDevice);
+			DispatchAxisChange(player, GetDispatchTable(player, event.mControllerType).Find(event.mId), event.mControllerType, event.mId, event.mValue, batched.mProcessedValue, event.mDevice, event.mTimestamp);
 		}
-		bindingGroup.mProcessingBinding = nullptr;
-		bindingGroup.Cleanup();
+		else if (batched.mLive)
+		{
+			HandleEvent(batched.mEvent);
+		}
+	}
+	mFlushingEvents.clear();
+	DeliverCursorFrames();
+	DeliverFrameEvents();
+	mFlushedSinceSwap = true;
+	KENGINE_INPUT_INSTRUMENT(mLastFrameLatency = mFrameLatency);
+	KENGINE_INPUT_INSTRUMENT(mFrameLatency = {});
+}
+
+float KEngineBasics::Input::ProcessAxis(PlayerInput& player, ControlIndex axis, float axisPosition)
+{
+	player.mRawAxes[axis] = axisPosition;
+	const AxisConditioning& conditioning = mAxisConditioning[axis];
+	if (!conditioning.mEnabled)
+	{
+		return axisPosition;
+	}
+	float partner = conditioning.mPartner != InvalidControlIndex ? player.mRawAxes[conditioning.mPartner] : 0.0f;
+	return ConditionAxis(axisPosition, partner, conditioning.mDeadZone, conditioning.mExponent, conditioning.mScale, conditioning.mSmoothing, GetBackState(player).mAxes[axis]);
+}
+
+// Conditions every axis value in the flushing batch together.  All the raw values are stored first, so both
+// axes of a radial pair see each other's value from this frame.  The arrays only ever grow, so once they are
+// a frame's size nothing allocates.
+void KEngineBasics::Input::ProcessBatchedAxes()
+{
+	AxisBatch& batch = mAxisBatch;
+	batch.mEvents.clear();
+	for (size_t i = 0; i < mFlushingEvents.size(); i++)
+	{
+		const BatchedEvent& batched = mFlushingEvents[i];
+		if (!batched.mLive || batched.mEvent.mType != AxisChangeEvent)
+		{
+			continue;
+		}
+		PlayerInput& player = GetEventPlayer(batched.mEvent.mControllerType, batched.mEvent.mDevice);
+		const ControlDispatch* control = GetDispatchTable(player, batched.mEvent.mControllerType).Find(batched.mEvent.mId);
+		if (control != nullptr && control->mAxisIndex != InvalidControlIndex)
+		{
+			player.mRawAxes[control->mAxisIndex] = batched.mEvent.mValue;
+			if (mAxisConditioning[control->mAxisIndex].mEnabled)
+			{
+				batch.mEvents.push_back(i);
+			}
+		}
+	}
+
+	size_t count = batch.mEvents.size();
+	if (count == 0)
+	{
+		return;
+	}
+	for (std::vector<float>* column : { &batch.mRaw, &batch.mPartnerRaw, &batch.mDeadZone, &batch.mExponent, &batch.mScale, &batch.mSmoothing, &batch.mPrevious, &batch.mProcessed })
+	{
+		column->resize(std::max(column->size(), count));
+	}
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const InputEvent& event = mFlushingEvents[batch.mEvents[i]].mEvent;
+		PlayerInput& player = GetEventPlayer(event.mControllerType, event.mDevice);
+		ControlIndex axis = GetDispatchTable(player, event.mControllerType).Find(event.mId)->mAxisIndex;
+		const AxisConditioning& conditioning = mAxisConditioning[axis];
+		batch.mRaw[i] = event.mValue;
+		batch.mPartnerRaw[i] = conditioning.mPartner != InvalidControlIndex ? player.mRawAxes[conditioning.mPartner] : 0.0f;
+		batch.mDeadZone[i] = conditioning.mDeadZone;
+		batch.mExponent[i] = conditioning.mExponent;
+		batch.mScale[i] = conditioning.mScale;
+		batch.mSmoothing[i] = conditioning.mSmoothing;
+		batch.mPrevious[i] = GetBackState(player).mAxes[axis];
+	}
+
+	const float* raw = batch.mRaw.data();
+	const float* partnerRaw = batch.mPartnerRaw.data();
+	const float* deadZone = batch.mDeadZone.data();
+	const float* exponent = batch.mExponent.data();
+	const float* scale = batch.mScale.data();
+	const float* smoothing = batch.mSmoothing.data();
+	const float* previous = batch.mPrevious.data();
+	float* processed = batch.mProcessed.data();
+	for (size_t i = 0; i < count; i++)
+	{
+		processed[i] = ConditionAxis(raw[i], partnerRaw[i], deadZone[i], exponent[i], scale[i], smoothing[i], previous[i]);
+	}
+
+	for (size_t i = 0; i < count; i++)
+	{
+		BatchedEvent& batched = mFlushingEvents[batch.mEvents[i]];
+		batched.mProcessed = true;
+		batched.mProcessedValue = processed[i];
 	}
 }
 
+std::span<const KEngineBasics::CursorSample> KEngineBasics::Input::GetCursorSamples(KEngineCore::StringHash cursorName, int player) const
+{
+	assert(player >= 0 && player < MaxPlayers);
+	return mPlayers[player].mCursorChannels.find(cursorName)->second.mFrameSamples;
+}
+
+KEngine2D::Point KEngineBasics::Input::GetCursorDelta(KEngineCore::StringHash cursorName, int player) const
+{
+	assert(player >= 0 && player < MaxPlayers);
+	return mPlayers[player].mCursorChannels.find(cursorName)->second.mFrameDelta;
+}
+
+void KEngineBasics::Input::RecordCursorSample(CursorChannel& channel, const KEngine2D::Point& position)
+{
+	if (channel.mHasLatest)
+	{
+		channel.mDelta.x += position.x - channel.mLatest.x;
+		channel.mDelta.y += position.y - channel.mLatest.y;
+	}
+	channel.mLatest = position;
+	channel.mHasLatest = true;
+	channel.mMoved = true;
+	if (channel.mHistoryBindingCount > 0 && channel.mSamples.size() < MaxCursorSamplesPerFrame)
+	{
+		channel.mSamples.push_back({ position, mEventTimestamp });	// when the sample arrived, however late it's dispatched
+	}
+}
+
+// Sample buffers are swapped rather than copied, so once they have grown to a frame's worth nothing allocates.
+void KEngineBasics::Input::DeliverCursorFrames()
+{
+	for (int player = 0; player < mPlayerCount; player++)
+	{
+		for (auto& channelPair : mPlayers[player].mCursorChannels)
+		{
+			CursorChannel& channel = channelPair.second;
+			std::swap(channel.mSamples, channel.mFrameSamples);
+			channel.mSamples.clear();
+			channel.mFrameDelta = channel.mDelta;
+			channel.mDelta = { 0.0, 0.0 };
+			if (channel.mMoved)
+			{
+				channel.mMoved = false;
+				KEngine2D::Point latest = channel.mLatest;
+				Dispatch(channel.mPerFrameBindings, [&](CursorPositionBinding* binding) {
+					binding->UpdateCursor(latest);
+				});
+			}
+		}
+	}
+}
 
 bool KEngineBasics::Input::HasCombinedAxis(KEngineCore::StringHash name) const
 {
@@ -1122,6 +1732,11 @@ bool KEngineBasics::Input::HasButton(KEngineCore::StringHash name) const
 	return mButtons.find(name) != mButtons.end();
 }
 
+bool KEngineBasics::Input::HasCombo(KEngineCore::StringHash name) const
+{
+	return mPlayers[0].mComboBindings.contains(name);
+}
+
 KEngineCore::StringHash KEngineBasics::Input::GetAxisForCombinedAxis(KEngineCore::StringHash combinedAxisName, AxisType axisType) const
 {
 	return mChildAxes.find({ combinedAxisName, axisType })->second;
@@ -1157,94 +1772,1315 @@ void KEngineBasics::Input::Pause()
 void KEngineBasics::Input::Resume()
 {
 	mPaused = false;
-	for (auto pair : mQueuedAxisUpdates)
-	{
-		HandleAxisChange(pair.first.type, pair.first.id, pair.second);
-	}
-	mQueuedAxisUpdates.clear();
-	for (auto entry : mQueuedButtonDowns)
+
+	// Move the live entries out first, so a callback that pauses again journals into an empty ring.  They go
+	// into a local buffer, so a callback that pauses and resumes again replays its own events without
+	// disturbing this loop; only such a nested Resume has to allocate.
+	std::vector<InputEvent> replaying = std::move(mReplayingJournal);
+	mReplayingJournal.clear();
+	replaying.clear();
+	for (uint64_t sequence = mPauseJournalStart; sequence < mPauseJournalEnd; sequence++)
 	{
-		HandleButtonDown(entry.type, entry.id);
+		const JournaledEvent& journaled = GetJournaledEvent(sequence);
+		if (journaled.mLive)
+		{
+			replaying.push_back(journaled.mEvent);
+		}
 	}
-	mQueuedButtonDowns.clear();
-	for (auto entry : mQueuedButtonUps)
+	ClearPauseJournal();
+
+	for (const InputEvent& event : replaying)
 	{
-		HandleButtonUp(entry.type, entry.id);
+		HandleEvent(event);
 	}
-	mQueuedButtonUps.clear();
-	for (auto entry : mQueuedCursorUpdates)
+	replaying.clear();
+	if (replaying.capacity() > mReplayingJournal.capacity())
 	{
-		HandleCursorPosition(entry.first, entry.second);
+		mReplayingJournal = std::move(replaying);
 	}
-	mQueuedCursorUpdates.clear();
 }
 
-bool KEngineBasics::Input::HasAxisMapping(ControllerType type, int axisId) const
+void KEngineBasics::Input::SetPauseJournalCapacity(size_t capacity)
 {
-	return mAxisMappings.find({ type, axisId }) != mAxisMappings.end();
+	assert(capacity > 0);
+	assert(mPauseJournalStart == mPauseJournalEnd);
+	mPauseJournal.resize(capacity);
+	mReplayingJournal.reserve(capacity);
+	RebuildJournaledControls(std::bit_ceil(capacity * 2));
 }
 
-bool KEngineBasics::Input::HasButtonMapping(ControllerType type, int axisId) const
+void KEngineBasics::Input::SetPauseCoalescing(int pauseCoalescingFlags)
 {
-	return mButtonMappings.find({ type, axisId }) != mButtonMappings.end();
+	mPauseCoalescing = pauseCoalescingFlags;
 }
 
-bool KEngineBasics::Input::HasCursorMapping(ControllerType type) const
+size_t KEngineBasics::Input::GetPauseJournalOverflowCount() const
 {
-	return mCursorMappings.find({ type }) != mCursorMappings.end();
+	return mPauseJournalOverflows;
 }
 
-KEngineCore::StringHash KEngineBasics::Input::GetAxisMapping(ControllerType type, int axisId) const 
+void KEngineBasics::Input::SetPostedEventCapacity(size_t capacity)
 {
-	return mAxisMappings.find({ type, axisId })->second;
+	mPostedEvents.Deinit();
+	mPostedEvents.Init(capacity);
 }
 
-KEngineCore::StringHash KEngineBasics::Input::GetButtonMapping(ControllerType type, int buttonId) const
+// Stamped here rather than when drained, so the latency includes the wait in the queue.
+bool KEngineBasics::Input::PostEvent(const InputEvent& posted)
 {
-	return mButtonMappings.find({ type, buttonId })->second;
+	InputEvent event = posted;
+	event.mTimestamp = StampIngestion(posted.mTimestamp);
+	return mPostedEvents.Push(event);
 }
 
-KEngineCore::StringHash KEngineBasics::Input::GetCursorMapping(ControllerType type) const
+size_t KEngineBasics::Input::DrainPostedEvents(bool batched)
 {
-	return mCursorMappings.find(type)->second;
+	size_t drained = 0;
+	InputEvent event;
+	while (mPostedEvents.Pop(event))
+	{
+		if (batched)
+		{
+			SubmitEvent(event);
+		}
+		else
+		{
+			HandleEvent(event);
+		}
+		drained++;
+	}
+	return drained;
 }
 
-KEngineBasics::Input::BindingGroup<AxisBinding>& KEngineBasics::Input::GetAxisBindings(KEngineCore::StringHash name)
+size_t KEngineBasics::Input::GetPostedEventOverflowCount() const
 {
-	return mAxisBindings.find(name)->second;
+	return mPostedEvents.GetOverflowCount();
 }
 
-KEngineBasics::Input::ButtonBindingPack& KEngineBasics::Input::GetButtonBindings(KEngineCore::StringHash name)
+const KEngineBasics::InputState& KEngineBasics::Input::GetState(int player) const
 {
-	return mButtonBindings.find(name)->second;
+	assert(player >= 0 && player < MaxPlayers);
+	return mPlayers[player].mStates[mFrontState];
 }
 
-KEngineBasics::Input::BindingGroup<CursorPositionBinding>& KEngineBasics::Input::GetCursorBindings(KEngineCore::StringHash name)
+void KEngineBasics::Input::SwapStateBuffers()
 {
-	return mCursorPositionBindings.find(name)->second;
+	mFrontState ^= 1;
+	for (int player = 0; player < mPlayerCount; player++)
+	{
+		GetBackState(mPlayers[player]).CarryOver(mPlayers[player].mStates[mFrontState]);
+	}
+	if (!std::exchange(mFlushedSinceSwap, false))
+	{
+		mFrameEvents.clear();
+	}
 }
 
-KEngineBasics::InputForwarder::InputForwarder()
+KEngineBasics::ControlIndex KEngineBasics::Input::GetButtonIndex(KEngineCore::StringHash name) const
 {
+	auto it = mButtonIndices.find(name);
+	return it != mButtonIndices.end() ? it->second : InvalidControlIndex;
 }
 
-KEngineBasics::InputForwarder::~InputForwarder()
+KEngineBasics::ControlIndex KEngineBasics::Input::GetAxisIndex(KEngineCore::StringHash name) const
 {
-	Deinit();
+	auto it = mAxisIndices.find(name);
+	return it != mAxisIndices.end() ? it->second : InvalidControlIndex;
 }
 
-void KEngineBasics::InputForwarder::Init(Input* input, std::function<void(ControllerType, int, int)> axisCallback, std::function<void(ControllerType, int)> buttonDownCallback, std::function<void(ControllerType, int)> buttonUpCallback, std::function<void(ControllerType, const KEngine2D::Point&)> cursorPositionCallback)
+KEngineBasics::ControlIndex KEngineBasics::Input::GetCursorIndex(KEngineCore::StringHash name) const
 {
-	assert(mInput == nullptr);
-	mAxisCallback = axisCallback;
-	mButtonDownCallback = buttonDownCallback;
-	mButtonUpCallback = buttonUpCallback;
-	mCursorPositionCallback = cursorPositionCallback;
-	mInput = input;
-	input->AddInputForwarder(this);
+	auto it = mCursorIndices.find(name);
+	return it != mCursorIndices.end() ? it->second : InvalidControlIndex;
 }
 
-void KEngineBasics::InputForwarder::Deinit(bool batched)
+const KEngineBasics::InputControlHandle* KEngineBasics::Input::GetControlHandle(KEngineCore::StringHash name)
+{
+	auto it = mControlHandles.find(name);
+	if (it == mControlHandles.end())
+	{
+		if (!HasButton(name) && !HasAxis(name) && !HasCursor(name) && !HasCombinedAxis(name) && !HasVirtualAxis(name) &&
+			!HasCombo(name) && !HasContext(name))
+		{
+			return nullptr;
+		}
+		it = mControlHandles.emplace(name, InputControlHandle{ name }).first;
+		mControlHandleAddresses.insert(&it->second);
+		RefreshControlHandle(name);
+	}
+	return &it->second;
+}
+
+const KEngineBasics::InputControlHandle* KEngineBasics::Input::FindControlHandle(const void* pointer) const
+{
+	return mControlHandleAddresses.contains(pointer) ? (const InputControlHandle*)pointer : nullptr;
+}
+
+// Takes the function at index as the frame handler, or with nil removes it.  The event tables are made as a
+// frame first needs them and kept with the handler, so steady-state frames create no garbage.
+void KEngineBasics::Input::SetFrameHandler(lua_State* luaState, int index)
+{
+	ClearFrameHandler();
+	if (lua_isnil(luaState, index))
+	{
+		return;
+	}
+	lua_pushvalue(luaState, index);
+	mFrameHandler = luaL_ref(luaState, LUA_REGISTRYINDEX);
+	lua_newtable(luaState);
+	mFrameEventTables = luaL_ref(luaState, LUA_REGISTRYINDEX);
+}
+
+void KEngineBasics::Input::ClearFrameHandler()
+{
+	if (mFrameHandler != LUA_NOREF)
+	{
+		lua_State* luaState = mScheduler->GetMainState();
+		luaL_unref(luaState, LUA_REGISTRYINDEX, mFrameHandler);
+		luaL_unref(luaState, LUA_REGISTRYINDEX, mFrameEventTables);
+		mFrameHandler = mFrameEventTables = LUA_NOREF;
+		mFrameEventTableCount = 0;
+	}
+	mFrameEvents.clear();
+}
+
+// Controls are only ever added, so the tables are stale exactly when they are short.
+void KEngineBasics::Input::RefreshFrameEventHandles()
+{
+	auto refresh = [this](std::vector<const InputControlHandle*>& handles, const std::map<KEngineCore::StringHash, ControlIndex>& indices) {
+		if (handles.size() != indices.size())
+		{
+			handles.resize(indices.size());
+			for (const auto& [name, index] : indices)
+			{
+				handles[index] = GetControlHandle(name);
+			}
+		}
+	};
+	refresh(mButtonHandles, mButtonIndices);
+	refresh(mAxisHandles, mAxisIndices);
+	refresh(mCursorHandles, mCursorIndices);
+}
+
+// Calls handler(events, count).  Each event is { handle, kind, value or x, y, player }, with the same handle
+// input.handle returns for the control's name and kind one of input.buttonDownEvent and friends.  Events
+// beyond count are left over from busier frames.  A handler that raises an error is logged and removed.
+void KEngineBasics::Input::DeliverFrameEvents()
+{
+	if (mFrameHandler == LUA_NOREF || mFrameEvents.empty())
+	{
+		return;
+	}
+	RefreshFrameEventHandles();
+	lua_State* luaState = mScheduler->GetMainState();
+	lua_rawgeti(luaState, LUA_REGISTRYINDEX, mFrameHandler);
+	lua_rawgeti(luaState, LUA_REGISTRYINDEX, mFrameEventTables);
+	int tables = lua_gettop(luaState);
+	for (size_t i = 0; i < mFrameEvents.size(); i++)
+	{
+		const FrameEvent& event = mFrameEvents[i];
+		const InputControlHandle* handle;
+		switch (event.mType)
+		{
+		case AxisChangeEvent:
+			handle = mAxisHandles[event.mControl];
+			break;
+		case CursorPositionEvent:
+			handle = mCursorHandles[event.mControl];
+			break;
+		default:
+			handle = mButtonHandles[event.mControl];
+			break;
+		}
+
+		if (i == mFrameEventTableCount)
+		{
+			lua_createtable(luaState, 5, 0);
+			lua_rawseti(luaState, tables, (lua_Integer)i + 1);
+			mFrameEventTableCount++;
+		}
+		lua_rawgeti(luaState, tables, (lua_Integer)i + 1);
+		lua_pushlightuserdata(luaState, (void*)handle);
+		lua_rawseti(luaState, -2, 1);
+		lua_pushinteger(luaState, event.mType);
+		lua_rawseti(luaState, -2, 2);
+		lua_pushnumber(luaState, event.mType == CursorPositionEvent ? event.mPosition.x : event.mValue);
+		lua_rawseti(luaState, -2, 3);
+		lua_pushnumber(luaState, event.mType == CursorPositionEvent ? event.mPosition.y : 0.0);
+		lua_rawseti(luaState, -2, 4);
+		lua_pushinteger(luaState, event.mPlayer);
+		lua_rawseti(luaState, -2, 5);
+		lua_pop(luaState, 1);
+	}
+	lua_pushinteger(luaState, (lua_Integer)mFrameEvents.size());
+
+	// Events the handler causes belong to the next frame.
+	mFrameEvents.clear();
+	if (lua_pcall(luaState, 2, 0, 0) != LUA_OK)
+	{
+		if (mLogger != nullptr)
+		{
+			const char* message = lua_tostring(luaState, -1);
+			mLogger->LogError("Input frame handler removed after an error: {}", message != nullptr ? message : "(error object is not a string)");
+		}
+		lua_pop(luaState, 1);
+		ClearFrameHandler();
+	}
+}
+
+// Registration without the per-call state resize and handle refresh, which callers do once they're done.
+void KEngineBasics::Input::RegisterAxis(KEngineCore::StringHash name, ControllerType controllerType, int id)
+{
+	mAxes.insert(name);
+	mAxisMappings[{ controllerType, id }] = name;
+	for (PlayerInput& player : mPlayers)
+	{
+		player.mAxisBindings.try_emplace(name);
+	}
+	mAxisIndices.try_emplace(name, (ControlIndex)mAxisIndices.size());
+	mDispatchTablesDirty = true;
+}
+
+void KEngineBasics::Input::RegisterButton(KEngineCore::StringHash name, ControllerType controllerType, int id)
+{
+	mButtons.insert(name);
+	mButtonMappings[{ controllerType, id }] = name;
+	for (PlayerInput& player : mPlayers)
+	{
+		player.mButtonBindings.try_emplace(name);
+	}
+	mButtonIndices.try_emplace(name, (ControlIndex)mButtonIndices.size());
+	mDispatchTablesDirty = true;
+}
+
+void KEngineBasics::Input::RegisterCursor(KEngineCore::StringHash name, ControllerType controllerType)
+{
+	mCursors.insert(name);
+	mCursorMappings[controllerType] = name;
+	for (PlayerInput& player : mPlayers)
+	{
+		player.mCursorChannels.try_emplace(name);
+	}
+	mCursorIndices.try_emplace(name, (ControlIndex)mCursorIndices.size());
+	mDispatchTablesDirty = true;
+}
+
+// A name can be registered as more kinds of control after its handle is made, so registration fills them in.
+void KEngineBasics::Input::RefreshControlHandle(KEngineCore::StringHash name)
+{
+	auto it = mControlHandles.find(name);
+	if (it != mControlHandles.end())
+	{
+		it->second.mButton = GetButtonIndex(name);
+		it->second.mAxis = GetAxisIndex(name);
+		it->second.mCursor = GetCursorIndex(name);
+	}
+}
+
+void KEngineBasics::Input::ResizeStates()
+{
+	for (PlayerInput& player : mPlayers)
+	{
+		for (InputState& state : player.mStates)
+		{
+			state.Resize(mButtonIndices.size(), mAxisIndices.size(), mCursorIndices.size());
+		}
+		player.mRawAxes.resize(mAxisIndices.size(), 0.0f);
+	}
+	mAxisConditioning.resize(mAxisIndices.size());
+	KENGINE_INPUT_INSTRUMENT(mStatistics.mButtonEventCounts.resize(mButtonIndices.size()));
+	KENGINE_INPUT_INSTRUMENT(mStatistics.mAxisEventCounts.resize(mAxisIndices.size()));
+	KENGINE_INPUT_INSTRUMENT(mStatistics.mCursorEventCounts.resize(mCursorIndices.size()));
+}
+
+const KEngineBasics::InputStatistics& KEngineBasics::Input::GetStatistics() const
+{
+	return mStatistics;
+}
+
+const KEngineBasics::InputLatency& KEngineBasics::Input::GetFrameLatency() const
+{
+	return mLastFrameLatency;
+}
+
+void KEngineBasics::Input::ResetStatistics()
+{
+	InputStatistics cleared;
+	cleared.mButtonEventCounts.swap(mStatistics.mButtonEventCounts);
+	cleared.mAxisEventCounts.swap(mStatistics.mAxisEventCounts);
+	cleared.mCursorEventCounts.swap(mStatistics.mCursorEventCounts);
+	std::fill(cleared.mButtonEventCounts.begin(), cleared.mButtonEventCounts.end(), 0);
+	std::fill(cleared.mAxisEventCounts.begin(), cleared.mAxisEventCounts.end(), 0);
+	std::fill(cleared.mCursorEventCounts.begin(), cleared.mCursorEventCounts.end(), 0);
+	mStatistics = std::move(cleared);
+}
+
+#ifdef KENGINE_INPUT_INSTRUMENTATION
+// Returns the running count of bindings visited, for EndInstrumentedEvent to take the difference.  Events
+// dispatched from inside a callback are counted on their own and again as part of the enclosing event.
+uint64_t KEngineBasics::Input::BeginInstrumentedEvent(InputEventType type, ControlIndex index)
+{
+	mStatistics.mEventCounts[type]++;
+	if (index == InvalidControlIndex)
+	{
+		mStatistics.mUnmappedEvents++;
+	}
+	else if (type == AxisChangeEvent)
+	{
+		mStatistics.mAxisEventCounts[index]++;
+	}
+	else if (type == CursorPositionEvent)
+	{
+		mStatistics.mCursorEventCounts[index]++;
+	}
+	else
+	{
+		mStatistics.mButtonEventCounts[index]++;
+	}
+	return mStatistics.mBindingsVisited;
+}
+
+void KEngineBasics::Input::EndInstrumentedEvent(uint64_t visitedBefore)
+{
+	mStatistics.mMaxBindingsVisitedPerEvent = std::max(mStatistics.mMaxBindingsVisitedPerEvent, mStatistics.mBindingsVisited - visitedBefore);
+}
+
+void KEngineBasics::Input::RecordCallback(std::chrono::steady_clock::duration duration)
+{
+	uint64_t nanoseconds = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+	int bucket = std::min((int)std::bit_width(nanoseconds) - 1, InputStatistics::CallbackHistogramBuckets - 1);
+	mStatistics.mCallbackHistogram[std::max(bucket, 0)]++;
+	mStatistics.mCallbackCount++;
+	mStatistics.mCallbackNanoseconds += nanoseconds;
+	mStatistics.mMaxCallbackNanoseconds = std::max(mStatistics.mMaxCallbackNanoseconds, nanoseconds);
+}
+
+// Only events carry an ingestion time, so work done outside dispatch (repeaters, per-frame cursor updates)
+// isn't recorded.
+void KEngineBasics::Input::RecordLatency(InputLatencyHistogram InputLatency::* histogram, std::chrono::steady_clock::time_point now)
+{
+	// Replayed events carry their recorded time, which can be ahead of the clock when played fast.
+	if (mEventTimestamp != std::chrono::steady_clock::time_point{} && now >= mEventTimestamp)
+	{
+		uint64_t nanoseconds = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now - mEventTimestamp).count();
+		(mStatistics.mLatency.*histogram).Record(nanoseconds);
+		(mFrameLatency.*histogram).Record(nanoseconds);
+	}
+}
+
+void KEngineBasics::Input::RecordLuaWake(lua_State* luaState)
+{
+	for (PendingLuaResume& pending : mPendingLuaResumes)
+	{
+		if (pending.mThread == luaState)
+		{
+			pending.mTimestamp = mEventTimestamp;
+			return;
+		}
+	}
+	mPendingLuaResumes.push_back({ luaState, mEventTimestamp });
+}
+
+void KEngineBasics::Input::RecordLuaResume(lua_State* luaState)
+{
+	for (size_t i = 0; i < mPendingLuaResumes.size(); i++)
+	{
+		if (mPendingLuaResumes[i].mThread == luaState)
+		{
+			std::chrono::steady_clock::time_point eventTimestamp = std::exchange(mEventTimestamp, mPendingLuaResumes[i].mTimestamp);
+			RecordLatency(&InputLatency::mLuaResume, std::chrono::steady_clock::now());
+			mEventTimestamp = eventTimestamp;
+			mPendingLuaResumes[i] = mPendingLuaResumes.back();
+			mPendingLuaResumes.pop_back();
+			return;
+		}
+	}
+}
+#endif
+
+void KEngineBasics::InputLatencyHistogram::Record(uint64_t nanoseconds)
+{
+	int bucket = std::min((int)std::bit_width(nanoseconds) - 1, (int)std::size(mHistogram) - 1);
+	mHistogram[std::max(bucket, 0)]++;
+	mCount++;
+	mNanoseconds += nanoseconds;
+	mMaxNanoseconds = std::max(mMaxNanoseconds, nanoseconds);
+}
+
+void KEngineBasics::Input::StartRepeating(InputRepeater* repeater)
+{
+	repeater->mContextMask = mDispatchingContexts != 0 ? mDispatchingContexts : GetBindingContextMask();
+	repeater->mPosition = mWaitingRepeaters.Add(repeater, repeater->mContextMask);
+	repeater->mWaiting = true;
+	StartFirstPeriod(repeater);
+}
+
+void KEngineBasics::Input::StopRepeating(InputRepeater* repeater)
+{
+	if (repeater->mWaiting)
+	{
+		repeater->mFirstPeriod.Cancel();
+		mWaitingRepeaters.Remove(repeater->mPosition);
+		repeater->mWaiting = repeater->mParked = false;
+		return;
+	}
+	auto it = mRepeatBuckets.find({ repeater->mTimer, repeater->mFrequency });
+	if (it != mRepeatBuckets.end() && it->second.mRepeaters.Remove(repeater->mPosition))
+	{
+		if (--it->second.mActiveCount == 0)
+		{
+			it->second.mTimeout.Cancel();
+		}
+	}
+}
+
+// Fires the repeater one period from now and moves it into its bucket, or parks it if its context has gone
+// inactive in the meantime.
+void KEngineBasics::Input::StartFirstPeriod(InputRepeater* repeater)
+{
+	repeater->mParked = false;
+	repeater->mFirstPeriod.Init(repeater->mTimer, 1.0 / repeater->mFrequency, false, [this, repeater]() {
+		if ((repeater->mContextMask & mActiveContexts) == 0)
+		{
+			repeater->mParked = true;
+			return;
+		}
+		mWaitingRepeaters.Remove(repeater->mPosition);
+		repeater->mWaiting = false;
+		JoinRepeatBucket(repeater);
+		uint64_t dispatchingContexts = std::exchange(mDispatchingContexts, repeater->mContextMask);
+		repeater->Fire();
+		mDispatchingContexts = dispatchingContexts;
+	});
+}
+
+// A bucket that is already running may tick at any point in the coming period, so a repeater joining it
+// sits out that tick.
+void KEngineBasics::Input::JoinRepeatBucket(InputRepeater* repeater)
+{
+	RepeatBucket& bucket = mRepeatBuckets[{ repeater->mTimer, repeater->mFrequency }];
+	repeater->mPosition = bucket.mRepeaters.Add(repeater, repeater->mContextMask);
+	repeater->mAligned = false;
+	if (bucket.mActiveCount++ == 0)
+	{
+		repeater->mAligned = true;
+		bucket.mTimeout.Init(repeater->mTimer, 1.0 / repeater->mFrequency, true, [this, &bucket]() {
+			// Repeaters nobody can hear leave the bucket, so that a bucket of them stops ticking.  Parking the
+			// last one cancels this Timeout, so nothing captured is used after that.
+			Input* input = this;
+			BindingGroup<InputRepeater>& repeaters = bucket.mRepeaters;
+			repeaters.ForEach([input](InputRepeater* repeater) {
+				if ((repeater->mContextMask & input->mActiveContexts) == 0)
+				{
+					input->ParkRepeater(repeater);
+				}
+			});
+			input->Dispatch(repeaters, [](InputRepeater* repeater) {
+				if (repeater->mAligned)
+				{
+					repeater->Fire();
+				}
+				repeater->mAligned = true;
+			});
+		});
+	}
+}
+
+void KEngineBasics::Input::ParkRepeater(InputRepeater* repeater)
+{
+	StopRepeating(repeater);
+	repeater->mPosition = mWaitingRepeaters.Add(repeater, repeater->mContextMask);
+	repeater->mWaiting = repeater->mParked = true;
+}
+
+// A parked repeater whose context is active again starts over with a full first period.
+void KEngineBasics::Input::UnparkRepeaters()
+{
+	mWaitingRepeaters.ForEachActive(mActiveContexts, [this](InputRepeater* repeater, uint64_t) {
+		if (repeater->mParked)
+		{
+			StartFirstPeriod(repeater);
+		}
+	});
+}
+
+// Coalescing keys: presses and releases of a button share one, and a cursor has one per controller and device.
+enum JournalKind : uint8_t
+{
+	JournalButton,
+	JournalAxis,
+	JournalCursor
+};
+
+static uint8_t GetJournalKind(InputEventType type)
+{
+	switch (type)
+	{
+	case AxisChangeEvent:
+		return JournalAxis;
+	case CursorPositionEvent:
+		return JournalCursor;
+	default:
+		return JournalButton;
+	}
+}
+
+static bool IsJournalContinuous(InputEventType type)
+{
+	return type == AxisChangeEvent || type == CursorPositionEvent;
+}
+
+static bool IsSameJournaledControl(const InputEvent& a, const InputEvent& b)
+{
+	uint8_t kind = GetJournalKind(a.mType);
+	return kind == GetJournalKind(b.mType) && a.mControllerType == b.mControllerType && a.mDevice == b.mDevice && (kind == JournalCursor || a.mId == b.mId);
+}
+
+static size_t HashJournaledControl(uint8_t kind, ControllerType type, int id, int device)
+{
+	uint64_t key = ((uint64_t)(uint32_t)id << 32) ^ ((uint64_t)(uint32_t)device << 8) ^ ((uint64_t)type << 2) ^ kind;
+	return (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+void KEngineBasics::Input::JournalEvent(const InputEvent& event)
+{
+	assert(!mPauseJournal.empty());
+	bool continuous = IsJournalContinuous(event.mType);
+	bool coalescing = (mPauseCoalescing & (continuous ? PauseCoalesceContinuous : PauseCoalesceButtonPairs)) != 0;
+	JournaledControl* journaledControl = nullptr;
+	if (coalescing)
+	{
+		// Rebuilding keeps only controls with live entries, at most the journal's capacity and so half the
+		// table, which keeps rebuilds rare.
+		if ((mJournaledControlCount + 1) * 4 > mJournaledControls.size() * 3)
+		{
+			RebuildJournaledControls(mJournaledControls.size());
+		}
+		journaledControl = &ProbeJournaledControl(event);
+		if (journaledControl->mGeneration == mJournalGeneration && journaledControl->mSequence >= mPauseJournalStart && journaledControl->mSequence < mPauseJournalEnd)
+		{
+			// Compaction can leave a cancelled entry's slot pointing at another control's entry, hence the check.
+			JournaledEvent& previous = GetJournaledEvent(journaledControl->mSequence);
+			if (previous.mLive && IsSameJournaledControl(previous.mEvent, event))
+			{
+				if (!continuous)
+				{
+					if (previous.mEvent.mType != event.mType)
+					{
+						previous.mLive = false;	// the pair cancels out
+						mPauseJournalLive--;
+					}
+					return;	// otherwise a repeat of a press or release that is still pending
+				}
+				previous.mLive = false;
+				mPauseJournalLive--;
+				mPauseJournalLiveContinuous--;
+			}
+		}
+	}
+
+	if (mPauseJournalEnd - mPauseJournalStart == mPauseJournal.size())
+	{
+		if (!MakeJournalRoom(continuous))
+		{
+			return;
+		}
+		if (coalescing)
+		{
+			journaledControl = &ProbeJournaledControl(event);	// growing the journal rebuilds the table
+		}
+	}
+
+	uint64_t sequence = mPauseJournalEnd++;
+	GetJournaledEvent(sequence) = { event, true };
+	mPauseJournalLive++;
+	if (continuous)
+	{
+		mPauseJournalLiveContinuous++;
+	}
+	if (coalescing)
+	{
+		SetJournaledControl(*journaledControl, event, sequence);
+	}
+}
+
+// Frees a slot in the full journal, or returns false if the new event, an axis or cursor update, has to be
+// dropped instead.  Cancelled entries at the start go first, then cancelled entries anywhere, then the oldest
+// axis or cursor update.  Only a journal of nothing but button edges grows.
+bool KEngineBasics::Input::MakeJournalRoom(bool continuous)
+{
+	while (mPauseJournalStart < mPauseJournalEnd && !GetJournaledEvent(mPauseJournalStart).mLive)
+	{
+		mPauseJournalStart++;
+	}
+	if (mPauseJournalEnd - mPauseJournalStart < mPauseJournal.size())
+	{
+		return true;
+	}
+
+	if (mPauseJournalLive < mPauseJournal.size())
+	{
+		CompactPauseJournal(false);
+	}
+	else if (mPauseJournalLiveContinuous > 0)
+	{
+		CompactPauseJournal(true);
+	}
+	else if (continuous)
+	{
+		mPauseJournalOverflows++;
+		return false;
+	}
+	else
+	{
+		GrowPauseJournal();
+	}
+	return true;
+}
+
+// Squeezes out cancelled entries, and with evictContinuous the oldest axis or cursor update too, keeping the
+// rest in order.  Entries only move towards the start, so none is overwritten before it is read.
+void KEngineBasics::Input::CompactPauseJournal(bool evictContinuous)
+{
+	uint64_t write = mPauseJournalStart;
+	for (uint64_t read = mPauseJournalStart; read < mPauseJournalEnd; read++)
+	{
+		JournaledEvent& journaled = GetJournaledEvent(read);
+		if (evictContinuous && journaled.mLive && IsJournalContinuous(journaled.mEvent.mType))
+		{
+			journaled.mLive = false;
+			evictContinuous = false;
+			mPauseJournalLive--;
+			mPauseJournalLiveContinuous--;
+			mPauseJournalOverflows++;
+		}
+		if (!journaled.mLive)
+		{
+			continue;
+		}
+		if (write != read)
+		{
+			GetJournaledEvent(write) = journaled;
+			JournaledControl& journaledControl = ProbeJournaledControl(journaled.mEvent);
+			if (journaledControl.mGeneration == mJournalGeneration && journaledControl.mSequence == read)
+			{
+				journaledControl.mSequence = write;
+			}
+		}
+		write++;
+	}
+	mPauseJournalEnd = write;
+}
+
+// Every entry is a pending button edge, none of which may be lost.  The entries are laid out again from
+// sequence 0, since the ring's size decides where each sequence lands.
+void KEngineBasics::Input::GrowPauseJournal()
+{
+	uint64_t count = mPauseJournalEnd - mPauseJournalStart;
+	std::vector<JournaledEvent> grown(mPauseJournal.size() * 2);
+	for (uint64_t i = 0; i < count; i++)
+	{
+		grown[i] = GetJournaledEvent(mPauseJournalStart + i);
+	}
+	mPauseJournal = std::move(grown);
+	mPauseJournalStart = 0;
+	mPauseJournalEnd = count;
+	mReplayingJournal.reserve(mPauseJournal.size());
+	RebuildJournaledControls(std::bit_ceil(mPauseJournal.size() * 2));
+}
+
+void KEngineBasics::Input::ClearPauseJournal()
+{
+	mPauseJournalStart = mPauseJournalEnd = 0;
+	mPauseJournalLive = mPauseJournalLiveContinuous = 0;
+	RebuildJournaledControls(mJournaledControls.size());
+}
+
+// The slot holding event's control, or if it has none, the free slot where it goes.
+KEngineBasics::Input::JournaledControl& KEngineBasics::Input::ProbeJournaledControl(const InputEvent& event)
+{
+	uint8_t kind = GetJournalKind(event.mType);
+	int id = kind == JournalCursor ? 0 : event.mId;
+	size_t mask = mJournaledControls.size() - 1;
+	for (size_t index = HashJournaledControl(kind, event.mControllerType, id, event.mDevice) & mask; ; index = (index + 1) & mask)
+	{
+		JournaledControl& journaledControl = mJournaledControls[index];
+		if (journaledControl.mGeneration != mJournalGeneration ||
+			(journaledControl.mKind == kind && journaledControl.mControl.type == event.mControllerType && journaledControl.mControl.id == id && journaledControl.mControl.device == event.mDevice))
+		{
+			return journaledControl;
+		}
+	}
+}
+
+void KEngineBasics::Input::SetJournaledControl(JournaledControl& journaledControl, const InputEvent& event, uint64_t sequence)
+{
+	if (journaledControl.mGeneration != mJournalGeneration)
+	{
+		uint8_t kind = GetJournalKind(event.mType);
+		journaledControl = { { event.mControllerType, kind == JournalCursor ? 0 : event.mId, event.mDevice }, sequence, mJournalGeneration, kind };
+		mJournaledControlCount++;
+	}
+	journaledControl.mSequence = sequence;
+}
+
+// Empties the table, by moving to a new generation unless it changes size, and enters the live entries again.
+void KEngineBasics::Input::RebuildJournaledControls(size_t size)
+{
+	if (mJournaledControls.size() != size)
+	{
+		mJournaledControls.assign(size, {});
+		mJournalGeneration = 1;
+	}
+	else if (++mJournalGeneration == 0)
+	{
+		// Wrapped, so slots from long ago would look current.
+		std::fill(mJournaledControls.begin(), mJournaledControls.end(), JournaledControl{});
+		mJournalGeneration = 1;
+	}
+	mJournaledControlCount = 0;
+	for (uint64_t sequence = mPauseJournalStart; sequence < mPauseJournalEnd; sequence++)
+	{
+		const JournaledEvent& journaled = GetJournaledEvent(sequence);
+		if (journaled.mLive && (mPauseCoalescing & (IsJournalContinuous(journaled.mEvent.mType) ? PauseCoalesceContinuous : PauseCoalesceButtonPairs)))
+		{
+			SetJournaledControl(ProbeJournaledControl(journaled.mEvent), journaled.mEvent, sequence);
+		}
+	}
+}
+
+bool KEngineBasics::Input::HasAxisMapping(ControllerType type, int axisId) const
+{
+	return mAxisMappings.find({ type, axisId }) != mAxisMappings.end();
+}
+
+bool KEngineBasics::Input::HasButtonMapping(ControllerType type, int axisId) const
+{
+	return mButtonMappings.find({ type, axisId }) != mButtonMappings.end();
+}
+
+bool KEngineBasics::Input::HasCursorMapping(ControllerType type) const
+{
+	return mCursorMappings.find({ type }) != mCursorMappings.end();
+}
+
+KEngineCore::StringHash KEngineBasics::Input::GetAxisMapping(ControllerType type, int axisId) const 
+{
+	return mAxisMappings.find({ type, axisId })->second;
+}
+
+KEngineCore::StringHash KEngineBasics::Input::GetButtonMapping(ControllerType type, int buttonId) const
+{
+	return mButtonMappings.find({ type, buttonId })->second;
+}
+
+KEngineCore::StringHash KEngineBasics::Input::GetCursorMapping(ControllerType type) const
+{
+	return mCursorMappings.find(type)->second;
+}
+
+KEngineBasics::Input::BindingGroup<AxisBinding>& KEngineBasics::Input::GetAxisBindings(PlayerInput& player, KEngineCore::StringHash name)
+{
+	return player.mAxisBindings.find(name)->second;
+}
+
+KEngineBasics::Input::ButtonBindingPack& KEngineBasics::Input::GetButtonBindings(PlayerInput& player, KEngineCore::StringHash name)
+{
+	return player.mButtonBindings.find(name)->second;
+}
+
+// Every player gets a channel, linked from the player's own converting button and cursor.  Registering a
+// name again moves its channels to the new button and cursor.
+void KEngineBasics::Input::RegisterVirtualAxis(KEngineCore::StringHash name, const VirtualAxisDescription& description)
+{
+	assert(HasCursor(description.mConvertedCursor));
+	assert(HasButton(description.mConvertingButton));
+	auto it = mVirtualAxes.find(name);
+	for (PlayerInput& player : mPlayers)
+	{
+		VirtualAxisChannel& channel = player.mVirtualAxes[name];
+		if (it != mVirtualAxes.end())
+		{
+			std::erase(GetButtonBindings(player, it->second.mConvertingButton).mVirtualAxes, &channel);
+			std::erase(GetCursorChannel(player, it->second.mConvertedCursor).mVirtualAxes, &channel);
+		}
+		GetButtonBindings(player, description.mConvertingButton).mVirtualAxes.push_back(&channel);
+		GetCursorChannel(player, description.mConvertedCursor).mVirtualAxes.push_back(&channel);
+	}
+
+	const VirtualAxisDescription& registered = mVirtualAxes[name] = description;
+	for (PlayerInput& player : mPlayers)
+	{
+		player.mVirtualAxes[name].mDescription = &registered;
+	}
+}
+
+void KEngineBasics::Input::UpdateVirtualAxes(const CursorChannel& channel, const KEngine2D::Point& position)
+{
+	for (VirtualAxisChannel* axis : channel.mVirtualAxes)
+	{
+		axis->mCurrentPosition = axis->mDescription->mAxisType == Horizontal ? position.x : position.y;
+		if (axis->mActive)
+		{
+			float converted = std::clamp((axis->mCurrentPosition - axis->mStartPosition) * axis->mDescription->mConversionRate, -1.0f, 1.0f);
+			Dispatch(axis->mBindings, [&](VirtualAxisBinding* binding) {
+				binding->Fire(converted);
+			});
+		}
+	}
+}
+
+void KEngineBasics::Input::StartVirtualAxes(const ButtonBindingPack& bindingPack)
+{
+	for (VirtualAxisChannel* axis : bindingPack.mVirtualAxes)
+	{
+		axis->mStartPosition = axis->mCurrentPosition;
+		axis->mActive = true;
+	}
+}
+
+void KEngineBasics::Input::StopVirtualAxes(const ButtonBindingPack& bindingPack)
+{
+	for (VirtualAxisChannel* axis : bindingPack.mVirtualAxes)
+	{
+		axis->mActive = false;
+		Dispatch(axis->mBindings, [](VirtualAxisBinding* binding) {
+			binding->Fire(0.0f);
+		});
+	}
+}
+
+KEngineBasics::Input::CursorChannel& KEngineBasics::Input::GetCursorChannel(PlayerInput& player, KEngineCore::StringHash name)
+{
+	return player.mCursorChannels.find(name)->second;
+}
+
+// Only players in use get tables; the rest are never dispatched to.
+void KEngineBasics::Input::RebuildDispatchTables()
+{
+	for (int playerIndex = 0; playerIndex < mPlayerCount; playerIndex++)
+	{
+		PlayerInput& player = mPlayers[playerIndex];
+		for (auto& table : player.mDispatchTables)
+		{
+			table = {};
+		}
+
+		for (auto& mapping : mButtonMappings)
+		{
+			ControlDispatch& control = player.mDispatchTables[mapping.first.first].Insert(mapping.first.second);
+			control.mButtonBindings = &GetButtonBindings(player, mapping.second);
+			control.mButtonIndex = GetButtonIndex(mapping.second);
+		}
+
+		for (auto& mapping : mAxisMappings)
+		{
+			ControlDispatch& control = player.mDispatchTables[mapping.first.first].Insert(mapping.first.second);
+			control.mAxisBindings = &GetAxisBindings(player, mapping.second);
+			control.mAxisIndex = GetAxisIndex(mapping.second);
+		}
+
+		for (auto& mapping : mCursorMappings)
+		{
+			player.mDispatchTables[mapping.first].mCursorChannel = &GetCursorChannel(player, mapping.second);
+			player.mDispatchTables[mapping.first].mCursorIndex = GetCursorIndex(mapping.second);
+		}
+	}
+
+	mDispatchTablesDirty = false;
+}
+
+const KEngineBasics::Input::ControlDispatch* KEngineBasics::Input::ControllerDispatchTable::Find(int id) const
+{
+	if (id <= MaxDenseControlId)
+	{
+		size_t index = id + 1;
+		return index < mDenseControls.size() ? &mDenseControls[index] : nullptr;
+	}
+	auto it = std::lower_bound(mSparseControls.begin(), mSparseControls.end(), id, [](const std::pair<int, ControlDispatch>& entry, int id) {
+		return entry.first < id;
+	});
+	return (it != mSparseControls.end() && it->first == id) ? &it->second : nullptr;
+}
+
+KEngineBasics::Input::ControlDispatch& KEngineBasics::Input::ControllerDispatchTable::Insert(int id)
+{
+	assert(id >= -1);
+	if (id <= MaxDenseControlId)
+	{
+		size_t index = id + 1;
+		if (index >= mDenseControls.size())
+		{
+			mDenseControls.resize(index + 1);
+		}
+		return mDenseControls[index];
+	}
+	auto it = std::lower_bound(mSparseControls.begin(), mSparseControls.end(), id, [](const std::pair<int, ControlDispatch>& entry, int id) {
+		return entry.first < id;
+	});
+	if (it == mSparseControls.end() || it->first != id)
+	{
+		it = mSparseControls.insert(it, { id, {} });
+	}
+	return it->second;
+}
+
+void KEngineBasics::Input::RebuildComboAutomaton()
+{
+	struct ChildStep
+	{
+		std::vector<ControlIndex>	mChord;
+		float						mMaxDelay;
+		uint32_t					mTarget;
+	};
+	std::vector<std::vector<ChildStep>> children(1);
+	mComboNodes.assign(1, {});
+
+	for (const ComboDefinition& definition : mComboDefinitions)
+	{
+		uint32_t node = 0;
+		for (const ComboStep& step : definition.mSteps)
+		{
+			std::vector<ControlIndex> chord;
+			for (KEngineCore::StringHash buttonName : step.mButtons)
+			{
+				chord.push_back(GetButtonIndex(buttonName));
+			}
+			std::sort(chord.begin(), chord.end());
+			chord.erase(std::unique(chord.begin(), chord.end()), chord.end());
+
+			auto it = std::find_if(children[node].begin(), children[node].end(), [&](const ChildStep& child) {
+				return child.mChord == chord && child.mMaxDelay == step.mMaxDelay;
+			});
+			if (it != children[node].end())
+			{
+				node = it->mTarget;
+			}
+			else
+			{
+				uint32_t target = (uint32_t)mComboNodes.size();
+				mComboNodes.emplace_back();
+				children.emplace_back();
+				children[node].push_back({ std::move(chord), step.mMaxDelay, target });
+				node = target;
+			}
+		}
+		mComboNodes[node].mCombo = (uint32_t)(&definition - mComboDefinitions.data());
+	}
+
+	mComboEdges.clear();
+	mComboChordButtons.clear();
+	for (uint32_t node = 0; node < mComboNodes.size(); node++)
+	{
+		ComboNode& comboNode = mComboNodes[node];
+		comboNode.mFirstEdge = (uint32_t)mComboEdges.size();
+		for (const ChildStep& child : children[node])
+		{
+			uint32_t firstChordButton = (uint32_t)mComboChordButtons.size();
+			mComboChordButtons.insert(mComboChordButtons.end(), child.mChord.begin(), child.mChord.end());
+			for (ControlIndex trigger : child.mChord)
+			{
+				mComboEdges.push_back({ trigger, firstChordButton, (uint32_t)child.mChord.size(), child.mMaxDelay, child.mTarget });
+			}
+			comboNode.mMaxDelay = std::max(comboNode.mMaxDelay, child.mMaxDelay);
+		}
+		comboNode.mEdgeCount = (uint32_t)mComboEdges.size() - comboNode.mFirstEdge;
+		std::sort(mComboEdges.begin() + comboNode.mFirstEdge, mComboEdges.end(), [](const ComboEdge& left, const ComboEdge& right) {
+			return left.mTrigger < right.mTrigger;
+		});
+	}
+
+	for (PlayerInput& player : mPlayers)
+	{
+		player.mComboPressTimes.assign(mButtonIndices.size(), {});
+		player.mComboPartials.clear();
+	}
+	mCombosDirty = false;
+}
+
+// Follows every edge the press of button can take, from the root and from each partial match still inside
+// its time window.  A completed combo consumes its presses: only the nodes where a combo just completed are
+// kept (so longer combos sharing the prefix can continue), and every other partial match starts over.
+void KEngineBasics::Input::AdvanceCombos(PlayerInput& player, ControlIndex button)
+{
+	if (mCombosDirty)
+	{
+		RebuildComboAutomaton();
+	}
+	if (button >= player.mComboPressTimes.size())
+	{
+		return;
+	}
+	// Go by when the press happened, not when dispatch reached it, so that journaled, batched and replayed
+	// presses complete and time out combos exactly as they did live.
+	std::chrono::steady_clock::time_point now = mEventTimestamp;
+	player.mComboPressTimes[button] = now;
+
+	size_t completedStart = mCompletedCombos.size();
+	mNextComboPartials.clear();
+	auto reach = [&](uint32_t node, bool completed) {
+		for (ComboPartial& partial : mNextComboPartials)
+		{
+			if (partial.mNode == node)
+			{
+				partial.mReached = now;
+				partial.mCompleted |= completed;
+				return;
+			}
+		}
+		mNextComboPartials.push_back({ node, now, completed });
+	};
+	auto follow = [&](const ComboPartial* partial) {
+		const ComboNode& node = mComboNodes[partial != nullptr ? partial->mNode : 0];
+		auto last = mComboEdges.begin() + node.mFirstEdge + node.mEdgeCount;
+		auto edge = std::lower_bound(mComboEdges.begin() + node.mFirstEdge, last, button, [](const ComboEdge& edge, ControlIndex button) {
+			return edge.mTrigger < button;
+		});
+		for (; edge != last && edge->mTrigger == button; ++edge)
+		{
+			if (partial != nullptr && now - partial->mReached > std::chrono::duration<float>(edge->mMaxDelay))
+			{
+				continue;
+			}
+			if (IsComboChordComplete(player, *edge, now))
+			{
+				uint32_t combo = mComboNodes[edge->mTarget].mCombo;
+				reach(edge->mTarget, combo != NoCombo);
+				if (combo != NoCombo)
+				{
+					mCompletedCombos.push_back(&player.mComboBindings.find(mComboDefinitions[combo].mName)->second);
+				}
+			}
+		}
+	};
+
+	for (const ComboPartial& partial : player.mComboPartials)
+	{
+		if (now - partial.mReached <= std::chrono::duration<float>(mComboNodes[partial.mNode].mMaxDelay))
+		{
+			mNextComboPartials.push_back({ partial.mNode, partial.mReached, false });
+			follow(&partial);
+		}
+	}
+	follow(nullptr);
+
+	if (mCompletedCombos.size() > completedStart)
+	{
+		std::erase_if(mNextComboPartials, [&](const ComboPartial& partial) {
+			return !partial.mCompleted || mComboNodes[partial.mNode].mEdgeCount == 0;
+		});
+	}
+	player.mComboPartials.swap(mNextComboPartials);
+
+	// Callbacks run last, as they may feed more input through here.
+	for (size_t i = completedStart; i < mCompletedCombos.size(); i++)
+	{
+		Dispatch(*mCompletedCombos[i], [](ComboBinding* binding) {
+			binding->Fire();
+		});
+	}
+	mCompletedCombos.resize(completedStart);
+}
+
+bool KEngineBasics::Input::IsComboChordComplete(const PlayerInput& player, const ComboEdge& edge, std::chrono::steady_clock::time_point now) const
+{
+	const InputState& state = player.mStates[mFrontState ^ 1];
+	for (uint32_t i = 0; i < edge.mChordSize; i++)
+	{
+		ControlIndex chordButton = mComboChordButtons[edge.mFirstChordButton + i];
+		if (!state.IsDown(chordButton) || now - player.mComboPressTimes[chordButton] > std::chrono::duration<float>(mComboChordWindow))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void KEngineBasics::InputState::Resize(size_t buttonCount, size_t axisCount, size_t cursorCount)
+{
+	size_t words = (buttonCount + 63) / 64;
+	mDown.resize(words, 0);
+	mPressed.resize(words, 0);
+	mReleased.resize(words, 0);
+	mAxes.resize(axisCount, 0.0f);
+	mCursors.resize(cursorCount, KEngine2D::Point{ 0.0, 0.0 });
+}
+
+void KEngineBasics::InputState::SetButton(ControlIndex button, bool down)
+{
+	uint64_t bit = uint64_t(1) << (button & 63);
+	uint64_t& held = mDown[button >> 6];
+	if (down && !(held & bit))
+	{
+		mPressed[button >> 6] |= bit;
+	}
+	else if (!down && (held & bit))
+	{
+		mReleased[button >> 6] |= bit;
+	}
+	held = down ? (held | bit) : (held & ~bit);
+}
+
+void KEngineBasics::InputState::CarryOver(const InputState& previous)
+{
+	// Same sizes on both sides, so these are straight copies with no allocation.
+	mDown = previous.mDown;
+	std::fill(mPressed.begin(), mPressed.end(), 0);
+	std::fill(mReleased.begin(), mReleased.end(), 0);
+	mAxes = previous.mAxes;
+	mCursors = previous.mCursors;
+}
+
+KEngineBasics::InputRepeater::InputRepeater()
+{
+}
+
+KEngineBasics::InputRepeater::~InputRepeater()
+{
+	Cancel();
+}
+
+void KEngineBasics::InputRepeater::Init(Input* inputSystem, KEngineCore::Timer* timer, float frequency, InlineFunction<void()> callback)
+{
+	assert(frequency > 0.0f);
+	Cancel();
+	mInputSystem = inputSystem;
+	mTimer = timer;
+	mFrequency = frequency;
+	mCallback = callback;
+	inputSystem->StartRepeating(this);
+}
+
+void KEngineBasics::InputRepeater::Cancel()
+{
+	if (mInputSystem != nullptr)
+	{
+		mInputSystem->StopRepeating(this);
+		mInputSystem = nullptr;
+	}
+}
+
+void KEngineBasics::InputRepeater::Fire()
+{
+	assert(mCallback);
+	mCallback();
+}
+
+KEngineBasics::ConcurrentInputEventQueue::ConcurrentInputEventQueue()
+{
+}
+
+KEngineBasics::ConcurrentInputEventQueue::~ConcurrentInputEventQueue()
+{
+	Deinit();
+}
+
+void KEngineBasics::ConcurrentInputEventQueue::Init(size_t capacity)
+{
+	assert(mCells == nullptr);
+	assert(capacity > 0);
+	size_t roundedCapacity = 1;
+	while (roundedCapacity < capacity)
+	{
+		roundedCapacity <<= 1;
+	}
+	mCells = std::make_unique<Cell[]>(roundedCapacity);
+	for (size_t i = 0; i < roundedCapacity; i++)
+	{
+		mCells[i].mSequence.store(i, std::memory_order_relaxed);
+	}
+	mMask = roundedCapacity - 1;
+	mEnqueuePosition.store(0, std::memory_order_relaxed);
+	mDequeuePosition.store(0, std::memory_order_relaxed);
+	mOverflows.store(0, std::memory_order_release);
+}
+
+void KEngineBasics::ConcurrentInputEventQueue::Deinit()
+{
+	mCells.reset();
+	mMask = 0;
+}
+
+bool KEngineBasics::ConcurrentInputEventQueue::Push(const InputEvent& event)
+{
+	assert(mCells != nullptr);
+	size_t position = mEnqueuePosition.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		Cell& cell = mCells[position & mMask];
+		size_t sequence = cell.mSequence.load(std::memory_order_acquire);
+		intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+		if (difference == 0)
+		{
+			if (mEnqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+			{
+				cell.mEvent = event;
+				cell.mSequence.store(position + 1, std::memory_order_release);
+				return true;
+			}
+		}
+		else if (difference < 0)
+		{
+			mOverflows.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		else
+		{
+			position = mEnqueuePosition.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+bool KEngineBasics::ConcurrentInputEventQueue::Pop(InputEvent& event)
+{
+	if (mCells == nullptr)
+	{
+		return false;
+	}
+	size_t position = mDequeuePosition.load(std::memory_order_relaxed);
+	Cell& cell = mCells[position & mMask];
+	size_t sequence = cell.mSequence.load(std::memory_order_acquire);
+	if ((intptr_t)sequence - (intptr_t)(position + 1) < 0)
+	{
+		return false;	// empty, or the producer that claimed this cell hasn't finished writing it
+	}
+	event = cell.mEvent;
+	cell.mSequence.store(position + mMask + 1, std::memory_order_release);
+	mDequeuePosition.store(position + 1, std::memory_order_relaxed);
+	return true;
+}
+
+size_t KEngineBasics::ConcurrentInputEventQueue::GetCapacity() const
+{
+	return mCells != nullptr ? mMask + 1 : 0;
+}
+
+size_t KEngineBasics::ConcurrentInputEventQueue::GetOverflowCount() const
+{
+	return mOverflows.load(std::memory_order_relaxed);
+}
+
+KEngineBasics::InputForwarder::InputForwarder()
+{
+}
+
+KEngineBasics::InputForwarder::~InputForwarder()
+{
+	Deinit();
+}
+
+void KEngineBasics::InputForwarder::Init(Input* input, InlineFunction<void(ControllerType, int, float)> axisCallback, InlineFunction<void(ControllerType, int)> buttonDownCallback, InlineFunction<void(ControllerType, int)> buttonUpCallback, InlineFunction<void(ControllerType, const KEngine2D::Point&)> cursorPositionCallback)
+{
+	assert(mInput == nullptr);
+	mAxisCallback = axisCallback;
+	mButtonDownCallback = buttonDownCallback;
+	mButtonUpCallback = buttonUpCallback;
+	mCursorPositionCallback = cursorPositionCallback;
+	mInput = input;
+	input->AddInputForwarder(this);
+}
+
+void KEngineBasics::InputForwarder::Deinit(bool batched)
 {
 	if (mInput && !batched)
 	{
@@ -1277,6 +3113,164 @@ void KEngineBasics::InputForwarder::HandleCursorPosition(ControllerType type, co
 	mCursorPositionCallback(type, position);
 }
 
+KEngineBasics::InputBindingSet::InputBindingSet()
+{
+}
+
+KEngineBasics::InputBindingSet::~InputBindingSet()
+{
+	Deinit();
+}
+
+void KEngineBasics::InputBindingSet::Init(InputLibrary* library)
+{
+	assert(mLibrary == nullptr);
+	mLibrary = library;
+	mNextSet = library->mBindingSets;
+	if (mNextSet != nullptr)
+	{
+		mNextSet->mPreviousSet = this;
+	}
+	library->mBindingSets = this;
+}
+
+void KEngineBasics::InputBindingSet::Deinit()
+{
+	if (mLibrary != nullptr)
+	{
+		ReleaseAll(mLibrary->mButtonDownPool, mButtonDownBindings);
+		ReleaseAll(mLibrary->mButtonUpPool, mButtonUpBindings);
+		ReleaseAll(mLibrary->mButtonHoldPool, mButtonHoldBindings);
+		ReleaseAll(mLibrary->mCombinedAxisPool, mCombinedAxisBindings);
+		ReleaseAll(mLibrary->mComboPool, mComboBindings);
+		if (mPreviousSet != nullptr)
+		{
+			mPreviousSet->mNextSet = mNextSet;
+		}
+		else
+		{
+			mLibrary->mBindingSets = mNextSet;
+		}
+		if (mNextSet != nullptr)
+		{
+			mNextSet->mPreviousSet = mPreviousSet;
+		}
+		mPreviousSet = nullptr;
+		mNextSet = nullptr;
+		mLibrary = nullptr;
+	}
+}
+
+KEngineBasics::ButtonDownBinding* KEngineBasics::InputBindingSet::AddButtonDownBinding()
+{
+	return Add(mLibrary->mButtonDownPool, mButtonDownBindings);
+}
+
+KEngineBasics::ButtonUpBinding* KEngineBasics::InputBindingSet::AddButtonUpBinding()
+{
+	return Add(mLibrary->mButtonUpPool, mButtonUpBindings);
+}
+
+KEngineBasics::ButtonHoldBinding* KEngineBasics::InputBindingSet::AddButtonHoldBinding()
+{
+	return Add(mLibrary->mButtonHoldPool, mButtonHoldBindings);
+}
+
+KEngineBasics::CombinedAxisBinding* KEngineBasics::InputBindingSet::AddCombinedAxisBinding()
+{
+	return Add(mLibrary->mCombinedAxisPool, mCombinedAxisBindings);
+}
+
+KEngineBasics::ComboBinding* KEngineBasics::InputBindingSet::AddComboBinding()
+{
+	return Add(mLibrary->mComboPool, mComboBindings);
+}
+
+template<typename BindingType>
+BindingType* KEngineBasics::InputBindingSet::Add(InputBindingPool<BindingType>& pool, typename InputBindingPool<BindingType>::Entry*& list)
+{
+	assert(mLibrary != nullptr);
+	auto* entry = pool.Acquire();
+	entry->mNext = list;
+	list = entry;
+	return entry->Get();
+}
+
+// Destroying each binding Deinits it, which unbinds it from Input and fires its cancel callback.
+template<typename BindingType>
+void KEngineBasics::InputBindingSet::ReleaseAll(InputBindingPool<BindingType>& pool, typename InputBindingPool<BindingType>::Entry*& list)
+{
+	assert(mLibrary != nullptr);
+	while (list != nullptr)
+	{
+		auto* entry = list;
+		list = entry->mNext;
+		pool.Release(entry);
+	}
+}
+
+// Reads the light userdata at index as a handle from input.handle, raising an error for any other pointer.
+static const KEngineBasics::InputControlHandle* CheckHandle(lua_State* luaState, int index, KEngineBasics::Input* inputSystem)
+{
+	const KEngineBasics::InputControlHandle* handle = inputSystem->FindControlHandle(lua_touserdata(luaState, index));
+	if (handle == nullptr)
+	{
+		luaL_error(luaState, "input: light userdata that isn't a handle from input.handle");
+	}
+	return handle;
+}
+
+// Reads the argument at index, a name or a handle from input.handle, as a hash.  Handles were hashed once
+// when input.handle made them, so scripts that keep them pay only a pointer lookup here.
+static KEngineCore::StringHash CheckName(lua_State* luaState, int index, KEngineBasics::Input* inputSystem)
+{
+	if (lua_type(luaState, index) == LUA_TLIGHTUSERDATA)
+	{
+		return CheckHandle(luaState, index, inputSystem)->mName;
+	}
+	return KEngineCore::StringHash(luaL_checkstring(luaState, index));
+}
+
+// Resolves the argument at index, a control name or a handle from input.handle, to one of its state indices.
+static KEngineBasics::ControlIndex CheckControlIndex(lua_State* luaState, int index, KEngineBasics::Input* inputSystem, KEngineBasics::ControlIndex KEngineBasics::InputControlHandle::* member, const char* kind)
+{
+	const KEngineBasics::InputControlHandle* handle;
+	if (lua_type(luaState, index) == LUA_TLIGHTUSERDATA)
+	{
+		handle = CheckHandle(luaState, index, inputSystem);
+	}
+	else
+	{
+		handle = inputSystem->GetControlHandle(luaL_checkstring(luaState, index));
+	}
+	if (handle == nullptr || handle->*member == KEngineBasics::InvalidControlIndex)
+	{
+		luaL_error(luaState, "no %s is registered with that name", kind);
+	}
+	return handle->*member;
+}
+
+// Calls function(name, valueIndex) for each name = value pair in the table at field of the table at index 1.
+// Keys may be names or handles from input.handle.
+template<typename Function>
+static void ForEachNamedBinding(lua_State* luaState, KEngineBasics::Input* inputSystem, const char* field, Function&& function)
+{
+	if (lua_getfield(luaState, 1, field) == LUA_TTABLE)
+	{
+		lua_pushnil(luaState);
+		while (lua_next(luaState, -2) != 0)
+		{
+			if (lua_type(luaState, -2) != LUA_TSTRING && lua_type(luaState, -2) != LUA_TLIGHTUSERDATA)
+			{
+				luaL_error(luaState, "input.bind: keys of %s must be control names or handles", field);
+			}
+			function(CheckName(luaState, -2, inputSystem), lua_gettop(luaState));
+			lua_pop(luaState, 1);
+		}
+	}
+	lua_pop(luaState, 1);
+}
+
 KEngineBasics::InputLibrary::InputLibrary()
 {
 }
@@ -1293,7 +3287,7 @@ void KEngineBasics::InputLibrary::Init(lua_State* luaState)
 			KEngineBasics::InputLibrary* inputLib = (KEngineBasics::InputLibrary*)lua_touserdata(luaState, lua_upvalueindex(1));
 			KEngineBasics::Input* inputSystem = inputLib->GetContextualObject(luaState, 3);
 			KEngineCore::LuaScheduler* scheduler = inputSystem->mScheduler;
-			KEngineCore::StringHash axisName(luaL_checkstring(luaState, 1));
+			KEngineCore::StringHash axisName = CheckName(luaState, 1, inputSystem);
 
 			luaL_checktype(luaState, 2, LUA_TFUNCTION);
 
@@ -1312,7 +3306,7 @@ void KEngineBasics::InputLibrary::Init(lua_State* luaState)
 			KEngineBasics::InputLibrary* inputLib = (KEngineBasics::InputLibrary*)lua_touserdata(luaState, lua_upvalueindex(1));
 			KEngineBasics::Input* inputSystem = inputLib->GetContextualObject(luaState, 2);
 			KEngineCore::LuaScheduler* scheduler = inputSystem->mScheduler;
-			KEngineCore::StringHash buttonName(luaL_checkstring(luaState, 1));
+			KEngineCore::StringHash buttonName = CheckName(luaState, 1, inputSystem);
 
 			ButtonDownBinding* binding = new (lua_newuserdata(luaState, sizeof(ButtonDownBinding))) ButtonDownBinding;
 			luaL_getmetatable(luaState, "KEngineBasics.ButtonDownBinding");
@@ -1321,7 +3315,8 @@ void KEngineBasics::InputLibrary::Init(lua_State* luaState)
 			KEngineCore::ScheduledLuaThread* scheduledThread = scheduler->GetScheduledThread(luaState);
 			scheduledThread->Pause();
 
-			binding->Init(inputSystem, buttonName, [scheduledThread]() {
+			binding->Init(inputSystem, buttonName, [scheduledThread, inputSystem, luaState]() {
+				KENGINE_INPUT_INSTRUMENT(inputSystem->RecordLuaWake(luaState));
 				scheduledThread->ClearCleanupCallback();
 				scheduledThread->Resume();
 			}, nullptr, true);
@@ -1330,14 +3325,29 @@ void KEngineBasics::InputLibrary::Init(lua_State* luaState)
 				binding->Deinit();
 			});
 
+#ifdef KENGINE_INPUT_INSTRUMENTATION
+			// The scheduler may resume the thread later than the callback asks it to, so latency is measured
+			// from the continuation, which runs when the thread really does.  It returns what resumed it, as
+			// a plain yield would.
+			lua_KFunction resumed = [](lua_State* luaState, int, lua_KContext inputIndex) {
+				KEngineBasics::Input* inputSystem = (KEngineBasics::Input*)lua_touserdata(luaState, (int)inputIndex);
+				inputSystem->RecordLuaResume(luaState);
+				return lua_gettop(luaState) - (int)inputIndex;
+			};
+			int inputIndex = lua_gettop(luaState);
+			lua_pushlightuserdata(luaState, inputSystem);
+			lua_insert(luaState, inputIndex);	// under the yielded binding, where the continuation will find it
+			return lua_yieldk(luaState, 1, inputIndex, resumed);
+#else
 			return lua_yield(luaState, 1);  //see Timer "waits" function
+#endif
 		};
 
 		auto setOnButtonDown = [](lua_State* luaState) {
 			KEngineBasics::InputLibrary* inputLib = (KEngineBasics::InputLibrary*)lua_touserdata(luaState, lua_upvalueindex(1));
 			KEngineBasics::Input* inputSystem = inputLib->GetContextualObject(luaState, 3);
 			KEngineCore::LuaScheduler* scheduler = inputSystem->mScheduler;
-			KEngineCore::StringHash buttonName(luaL_checkstring(luaState, 1));
+			KEngineCore::StringHash buttonName = CheckName(luaState, 1, inputSystem);
 
 			luaL_checktype(luaState, 2, LUA_TFUNCTION);
 
@@ -1354,7 +3364,7 @@ void KEngineBasics::InputLibrary::Init(lua_State* luaState)
 			KEngineBasics::InputLibrary* inputLib = (KEngineBasics::InputLibrary*)lua_touserdata(luaState, lua_upvalueindex(1));
 			KEngineBasics::Input* inputSystem = inputLib->GetContextualObject(luaState, 4);
 			KEngineCore::LuaScheduler* scheduler = inputSystem->mScheduler;
-			KEngineCore::StringHash buttonName(luaL_checkstring(luaState, 1));
+			KEngineCore::StringHash buttonName = CheckName(luaState, 1, inputSystem);
 
 			float frequency = luaL_checknumber(luaState, 2);
 
@@ -1373,7 +3383,7 @@ void KEngineBasics::InputLibrary::Init(lua_State* luaState)
 			KEngineBasics::InputLibrary* inputLib = (KEngineBasics::InputLibrary*)lua_touserdata(luaState, lua_upvalueindex(1));
 			KEngineBasics::Input* inputSystem = inputLib->GetContextualObject(luaState, 3);
 			KEngineCore::LuaScheduler* scheduler = inputSystem->mScheduler;
-			KEngineCore::StringHash buttonName(luaL_checkstring(luaState, 1));
+			KEngineCore::StringHash buttonName = CheckName(luaState, 1, inputSystem);
 
 			luaL_checktype(luaState, 2, LUA_TFUNCTION);
 
@@ -1386,12 +3396,277 @@ void KEngineBasics::InputLibrary::Init(lua_State* luaState)
 			return 1;
 		};
 
+		auto setOnCombo = [](lua_State* luaState) {
+			KEngineBasics::InputLibrary* inputLib = (KEngineBasics::InputLibrary*)lua_touserdata(luaState, lua_upvalueindex(1));
+			KEngineBasics::Input* inputSystem = inputLib->GetContextualObject(luaState, 3);
+			KEngineCore::LuaScheduler* scheduler = inputSystem->mScheduler;
+			KEngineCore::StringHash comboName = CheckName(luaState, 1, inputSystem);
+
+			luaL_checktype(luaState, 2, LUA_TFUNCTION);
+
+			ComboBinding* binding = new (lua_newuserdata(luaState, sizeof(ComboBinding))) ComboBinding;
+			luaL_getmetatable(luaState, "KEngineBasics.ComboBinding");
+			lua_setmetatable(luaState, -2);
+
+			KEngineCore::ScheduledLuaCallback<> callback = scheduler->CreateCallback<>(luaState, 2);
+			binding->Init(inputSystem, comboName, callback.mCallback, callback.mCancelCallback);
+			return 1;
+		};
+
+		// input.bind{ buttonDown = { jump = f }, buttonUp = { ... }, buttonHold = { run = { frequency, f } },
+		//             combinedAxisTilt = { move = f }, combo = { hadouken = f } }
+		// Registers every binding in one call and returns a single handle for input.unbind.
+		auto bind = [](lua_State* luaState) {
+			KEngineBasics::InputLibrary* inputLib = (KEngineBasics::InputLibrary*)lua_touserdata(luaState, lua_upvalueindex(1));
+			KEngineBasics::Input* inputSystem = inputLib->GetContextualObject(luaState, 2);
+			KEngineCore::LuaScheduler* scheduler = inputSystem->mScheduler;
+			luaL_checktype(luaState, 1, LUA_TTABLE);
+
+			InputBindingSet* bindingSet = new (lua_newuserdata(luaState, sizeof(InputBindingSet))) InputBindingSet;
+			luaL_getmetatable(luaState, InputBindingSet::MetaName);
+			lua_setmetatable(luaState, -2);
+			bindingSet->Init(inputLib);
+
+			ForEachNamedBinding(luaState, inputSystem, "buttonDown", [&](KEngineCore::StringHash buttonName, int valueIndex) {
+				luaL_checktype(luaState, valueIndex, LUA_TFUNCTION);
+				KEngineCore::ScheduledLuaCallback<> callback = scheduler->CreateCallback<>(luaState, valueIndex);
+				bindingSet->AddButtonDownBinding()->Init(inputSystem, buttonName, callback.mCallback, callback.mCancelCallback);
+			});
+			ForEachNamedBinding(luaState, inputSystem, "buttonUp", [&](KEngineCore::StringHash buttonName, int valueIndex) {
+				luaL_checktype(luaState, valueIndex, LUA_TFUNCTION);
+				KEngineCore::ScheduledLuaCallback<> callback = scheduler->CreateCallback<>(luaState, valueIndex);
+				bindingSet->AddButtonUpBinding()->Init(inputSystem, buttonName, callback.mCallback, callback.mCancelCallback);
+			});
+			ForEachNamedBinding(luaState, inputSystem, "buttonHold", [&](KEngineCore::StringHash buttonName, int valueIndex) {
+				luaL_checktype(luaState, valueIndex, LUA_TTABLE);
+				lua_rawgeti(luaState, valueIndex, 1);
+				float frequency = (float)luaL_checknumber(luaState, -1);
+				lua_rawgeti(luaState, valueIndex, 2);
+				luaL_checktype(luaState, -1, LUA_TFUNCTION);
+				KEngineCore::ScheduledLuaCallback<> callback = scheduler->CreateCallback<>(luaState, lua_gettop(luaState));
+				bindingSet->AddButtonHoldBinding()->Init(inputSystem, inputSystem->mTimer, buttonName, frequency, callback.mCallback, callback.mCancelCallback);
+				lua_pop(luaState, 2);
+			});
+			ForEachNamedBinding(luaState, inputSystem, "combinedAxisTilt", [&](KEngineCore::StringHash axisName, int valueIndex) {
+				luaL_checktype(luaState, valueIndex, LUA_TFUNCTION);
+				float deadZone = 0.1;
+				float frequency = 30;
+				KEngineCore::ScheduledLuaCallback<KEngine2D::Point> callback = scheduler->CreateCallback<KEngine2D::Point>(luaState, valueIndex);
+				bindingSet->AddCombinedAxisBinding()->Init(inputSystem, inputSystem->mTimer, axisName, deadZone, frequency, callback.mCallback, callback.mCancelCallback);
+			});
+			ForEachNamedBinding(luaState, inputSystem, "combo", [&](KEngineCore::StringHash comboName, int valueIndex) {
+				luaL_checktype(luaState, valueIndex, LUA_TFUNCTION);
+				KEngineCore::ScheduledLuaCallback<> callback = scheduler->CreateCallback<>(luaState, valueIndex);
+				bindingSet->AddComboBinding()->Init(inputSystem, comboName, callback.mCallback, callback.mCancelCallback);
+			});
+			return 1;
+		};
+
+		auto unbind = [](lua_State* luaState) {
+			InputBindingSet* bindingSet = (InputBindingSet*)luaL_checkudata(luaState, 1, InputBindingSet::MetaName);
+			bindingSet->Deinit();
+			return 0;
+		};
+
+		// input.handle(name) hashes and resolves a name once; every function in this library takes the handle
+		// wherever it takes a name.  The name must already be a registered control, combo or context.  Polling
+		// reads the snapshot published by the last Input::SwapStateBuffers, for the player chosen by input.setPlayer.
+		auto handle = [](lua_State* luaState) {
+			KEngineBasics::InputLibrary* inputLib = (KEngineBasics::InputLibrary*)lua_touserdata(luaState, lua_upvalueindex(1));
+			KEngineBasics::Input* inputSystem = inputLib->GetContextualObject(luaState, 2);
+			const InputControlHandle* controlHandle = inputSystem->GetControlHandle(luaL_checkstring(luaState, 1));
+			if (controlHandle == nullptr)
+			{
+				luaL_error(luaState, "input.handle: no control, combo or context is registered as %s", lua_tostring(luaState, 1));
+			}
+			lua_pushlightuserdata(luaState, (void*)controlHandle);
+			return 1;
+		};
+
+		auto isDown = [](lua_State* luaState) {
+			KEngineBasics::InputLibrary* inputLib = (KEngineBasics::InputLibrary*)lua_touserdata(luaState, lua_upvalueindex(1));
+			KEngineBasics::Input* inputSystem = inputLib->GetContextualObject(luaState, 2);
+			ControlIndex button = CheckControlIndex(luaState, 1, inputSystem, &InputControlHandle::mButton, "button");
+			lua_pushboolean(luaState, inputSystem->GetState(inputSystem->GetBindingPlayer()).IsDown(button));
+			return 1;
+		};
+
+		auto wasPressed = [](lua_State* luaState) {
+			KEngineBasics::InputLibrary* inputLib = (KEngineBasics::InputLibrary*)lua_touserdata(luaState, lua_upvalueindex(1));
+			KEngineBasics::Input* inputSystem = inputLib->GetContextualObject(luaState, 2);
+			ControlIndex button = CheckControlIndex(luaState, 1, inputSystem, &InputControlHandle::mButton, "button");
+			lua_pushboolean(luaState, inputSystem->GetState(inputSystem->GetBindingPlayer()).WasPressed(button));
+			return 1;
+		};
+
+		auto wasReleased = [](lua_State* luaState) {
+			KEngineBasics::InputLibrary* inputLib = (KEngineBasics::InputLibrary*)lua_touserdata(luaState, lua_upvalueindex(1));
+			KEngineBasics::Input* inputSystem = inputLib->GetContextualObject(luaState, 2);
+			ControlIndex button = CheckControlIndex(luaState, 1, inputSystem, &InputControlHandle::mButton, "button");
+			lua_pushboolean(luaState, inputSystem->GetState(inputSystem->GetBindingPlayer()).WasReleased(button));
+			return 1;
+		};
+
+		auto axis = [](lua_State* luaState) {
+			KEngineBasics::InputLibrary* inputLib = (KEngineBasics::InputLibrary*)lua_touserdata(luaState, lua_upvalueindex(1));
+			KEngineBasics::Input* inputSystem = inputLib->GetContextualObject(luaState, 2);
+			ControlIndex axis = CheckControlIndex(luaState, 1, inputSystem, &InputControlHandle::mAxis, "axis");
+			lua_pushnumber(luaState, inputSystem->GetState(inputSystem->GetBindingPlayer()).GetAxis(axis));
+			return 1;
+		};
+
+		auto cursor = [](lua_State* luaState) {
+			KEngineBasics::InputLibrary* inputLib = (KEngineBasics::InputLibrary*)lua_touserdata(luaState, lua_upvalueindex(1));
+			KEngineBasics::Input* inputSystem = inputLib->GetContextualObject(luaState, 2);
+			ControlIndex cursor = CheckControlIndex(luaState, 1, inputSystem, &InputControlHandle::mCursor, "cursor");
+			const KEngine2D::Point& position = inputSystem->GetState(inputSystem->GetBindingPlayer()).GetCursor(cursor);
+			lua_pushnumber(luaState, position.x);
+			lua_pushnumber(luaState, position.y);
+			return 2;
+		};
+
+		auto pushContext = [](lua_State* luaState) {
+			KEngineBasics::InputLibrary* inputLib = (KEngineBasics::InputLibrary*)lua_touserdata(luaState, lua_upvalueindex(1));
+			KEngineBasics::Input* inputSystem = inputLib->GetContextualObject(luaState, 2);
+			inputSystem->PushContext(CheckName(luaState, 1, inputSystem));
+			return 0;
+		};
+
+		auto popContext = [](lua_State* luaState) {
+			KEngineBasics::InputLibrary* inputLib = (KEngineBasics::InputLibrary*)lua_touserdata(luaState, lua_upvalueindex(1));
+			KEngineBasics::Input* inputSystem = inputLib->GetContextualObject(luaState, 2);
+			inputSystem->PopContext(CheckName(luaState, 1, inputSystem));
+			return 0;
+		};
+
+		auto setContextEnabled = [](lua_State* luaState) {
+			KEngineBasics::InputLibrary* inputLib = (KEngineBasics::InputLibrary*)lua_touserdata(luaState, lua_upvalueindex(1));
+			KEngineBasics::Input* inputSystem = inputLib->GetContextualObject(luaState, 3);
+			luaL_checktype(luaState, 2, LUA_TBOOLEAN);
+			inputSystem->SetContextEnabled(CheckName(luaState, 1, inputSystem), lua_toboolean(luaState, 2));
+			return 0;
+		};
+
+		auto isContextActive = [](lua_State* luaState) {
+			KEngineBasics::InputLibrary* inputLib = (KEngineBasics::InputLibrary*)lua_touserdata(luaState, lua_upvalueindex(1));
+			KEngineBasics::Input* inputSystem = inputLib->GetContextualObject(luaState, 2);
+			lua_pushboolean(luaState, inputSystem->IsContextActive(CheckName(luaState, 1, inputSystem)));
+			return 1;
+		};
+
+		// Bindings made from Lua after this call belong to the named context.
+		auto setBindingContext = [](lua_State* luaState) {
+			KEngineBasics::InputLibrary* inputLib = (KEngineBasics::InputLibrary*)lua_touserdata(luaState, lua_upvalueindex(1));
+			KEngineBasics::Input* inputSystem = inputLib->GetContextualObject(luaState, 2);
+			inputSystem->SetBindingContext(CheckName(luaState, 1, inputSystem));
+			return 0;
+		};
+
+		// Bindings made from Lua after this call, and polling, are for the given player (0 based).
+		auto setPlayer = [](lua_State* luaState) {
+			KEngineBasics::InputLibrary* inputLib = (KEngineBasics::InputLibrary*)lua_touserdata(luaState, lua_upvalueindex(1));
+			KEngineBasics::Input* inputSystem = inputLib->GetContextualObject(luaState, 2);
+			lua_Integer player = luaL_checkinteger(luaState, 1);
+			if (player < 0 || player >= Input::MaxPlayers)
+			{
+				return luaL_error(luaState, "player %d out of range", (int)player);
+			}
+			inputSystem->SetBindingPlayer((int)player);
+			return 0;
+		};
+
+		// Per-control counts are arrays indexed by ControlIndex + 1; everything is zero unless Input was built
+		// with KENGINE_INPUT_INSTRUMENTATION.
+		auto getStatistics = [](lua_State* luaState) {
+			KEngineBasics::InputLibrary* inputLib = (KEngineBasics::InputLibrary*)lua_touserdata(luaState, lua_upvalueindex(1));
+			KEngineBasics::Input* inputSystem = inputLib->GetContextualObject(luaState, 1);
+			const InputStatistics& statistics = inputSystem->GetStatistics();
+
+			auto pushCounts = [luaState](const uint64_t* counts, size_t count) {
+				lua_createtable(luaState, (int)count, 0);
+				for (size_t i = 0; i < count; i++)
+				{
+					lua_pushinteger(luaState, (lua_Integer)counts[i]);
+					lua_rawseti(luaState, -2, i + 1);
+				}
+			};
+
+			lua_createtable(luaState, 0, 13);
+			lua_pushinteger(luaState, (lua_Integer)statistics.mEventCounts[AxisChangeEvent]);
+			lua_setfield(luaState, -2, "axisEvents");
+			lua_pushinteger(luaState, (lua_Integer)statistics.mEventCounts[ButtonDownEvent]);
+			lua_setfield(luaState, -2, "buttonDownEvents");
+			lua_pushinteger(luaState, (lua_Integer)statistics.mEventCounts[ButtonUpEvent]);
+			lua_setfield(luaState, -2, "buttonUpEvents");
+			lua_pushinteger(luaState, (lua_Integer)statistics.mEventCounts[CursorPositionEvent]);
+			lua_setfield(luaState, -2, "cursorEvents");
+			lua_pushinteger(luaState, (lua_Integer)statistics.mUnmappedEvents);
+			lua_setfield(luaState, -2, "unmappedEvents");
+			pushCounts(statistics.mButtonEventCounts.data(), statistics.mButtonEventCounts.size());
+			lua_setfield(luaState, -2, "buttons");
+			pushCounts(statistics.mAxisEventCounts.data(), statistics.mAxisEventCounts.size());
+			lua_setfield(luaState, -2, "axes");
+			pushCounts(statistics.mCursorEventCounts.data(), statistics.mCursorEventCounts.size());
+			lua_setfield(luaState, -2, "cursors");
+			lua_pushinteger(luaState, (lua_Integer)statistics.mBindingsVisited);
+			lua_setfield(luaState, -2, "bindingsVisited");
+			lua_pushinteger(luaState, (lua_Integer)statistics.mMaxBindingsVisitedPerEvent);
+			lua_setfield(luaState, -2, "maxBindingsVisitedPerEvent");
+			lua_pushinteger(luaState, (lua_Integer)statistics.mCallbackCount);
+			lua_setfield(luaState, -2, "callbacks");
+			lua_pushnumber(luaState, statistics.mCallbackNanoseconds * 1e-9);
+			lua_setfield(luaState, -2, "callbackSeconds");
+			lua_pushnumber(luaState, statistics.mMaxCallbackNanoseconds * 1e-9);
+			lua_setfield(luaState, -2, "maxCallbackSeconds");
+			pushCounts(statistics.mCallbackHistogram, InputStatistics::CallbackHistogramBuckets);
+			lua_setfield(luaState, -2, "callbackHistogram");
+			return 1;
+		};
+
+		// input.setFrameHandler(function(events, count) ... end) has every button, axis and cursor event
+		// delivered once per Flush in a single call, instead of one callback per event; nil removes it.
+		auto setFrameHandler = [](lua_State* luaState) {
+			KEngineBasics::InputLibrary* inputLib = (KEngineBasics::InputLibrary*)lua_touserdata(luaState, lua_upvalueindex(1));
+			KEngineBasics::Input* inputSystem = inputLib->GetContextualObject(luaState, 2);
+			if (!lua_isnil(luaState, 1))
+			{
+				luaL_checktype(luaState, 1, LUA_TFUNCTION);
+			}
+			inputSystem->SetFrameHandler(luaState, 1);
+			return 0;
+		};
+
+		auto resetStatistics = [](lua_State* luaState) {
+			KEngineBasics::InputLibrary* inputLib = (KEngineBasics::InputLibrary*)lua_touserdata(luaState, lua_upvalueindex(1));
+			KEngineBasics::Input* inputSystem = inputLib->GetContextualObject(luaState, 1);
+			inputSystem->ResetStatistics();
+			return 0;
+		};
+
 		const luaL_Reg inputLibrary[] = {
 			{"setOnCombinedAxisTilt", setOnCombinedAxisTilt},
 			{"waitForButtonDown", waitForButtonDown},
 			{"setOnButtonDown", setOnButtonDown},
 			{"setOnButtonHold", setOnButtonHold},
 			{"setOnButtonUp", setOnButtonUp},
+			{"setOnCombo", setOnCombo},
+			{"bind", bind},
+			{"handle", handle},
+			{"isDown", isDown},
+			{"wasPressed", wasPressed},
+			{"wasReleased", wasReleased},
+			{"axis", axis},
+			{"cursor", cursor},
+			{"unbind", unbind},
+			{"pushContext", pushContext},
+			{"popContext", popContext},
+			{"setContextEnabled", setContextEnabled},
+			{"isContextActive", isContextActive},
+			{"setBindingContext", setBindingContext},
+			{"setPlayer", setPlayer},
+			{"getStatistics", getStatistics},
+			{"resetStatistics", resetStatistics},
+			{"setFrameHandler", setFrameHandler},
 			{nullptr, nullptr}
 		};
 
@@ -1399,10 +3674,22 @@ void KEngineBasics::InputLibrary::Init(lua_State* luaState)
 		KEngineCore::CreateGCMetaTableForClass<ButtonDownBinding, ButtonDownBinding::MetaName>(luaState);
 		KEngineCore::CreateGCMetaTableForClass<ButtonHoldBinding, ButtonHoldBinding::MetaName>(luaState);
 		KEngineCore::CreateGCMetaTableForClass<ButtonUpBinding, ButtonUpBinding::MetaName>(luaState);
+		KEngineCore::CreateGCMetaTableForClass<ComboBinding, ComboBinding::MetaName>(luaState);
+		KEngineCore::CreateGCMetaTableForClass<InputBindingSet, InputBindingSet::MetaName>(luaState);
 
 		luaL_newlibtable(luaState, inputLibrary);
 		lua_pushvalue(luaState, lua_upvalueindex(1));
 		luaL_setfuncs(luaState, inputLibrary, 1);
+
+		// Event kinds, as frame handlers see them.
+		lua_pushinteger(luaState, AxisChangeEvent);
+		lua_setfield(luaState, -2, "axisChangeEvent");
+		lua_pushinteger(luaState, ButtonDownEvent);
+		lua_setfield(luaState, -2, "buttonDownEvent");
+		lua_pushinteger(luaState, ButtonUpEvent);
+		lua_setfield(luaState, -2, "buttonUpEvent");
+		lua_pushinteger(luaState, CursorPositionEvent);
+		lua_setfield(luaState, -2, "cursorPositionEvent");
 		return 1;
 	};
 
@@ -1410,8 +3697,14 @@ void KEngineBasics::InputLibrary::Init(lua_State* luaState)
 
 }
 
+// Sets Lua hasn't collected yet release their bindings now, while the pools still own the storage; their
+// finalizers find them detached.
 void KEngineBasics::InputLibrary::Deinit()
 {
+	while (mBindingSets != nullptr)
+	{
+		mBindingSets->Deinit();
+	}
 	LuaLibraryTwo::Deinit();
 }
 
@@ -4,16 +4,24 @@
 #include "StringHash.h"
 #include "LuaLibrary.h"
 #include "Timer.h"
+#include "InlineFunction.h"
 #include <set>
 #include <map>
 #include <vector>
 #include <list>
+#include <span>
 #include <compare>
+#include <chrono>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <cstdint>
 
 
 namespace KEngineCore
 {
 	class LuaScheduler;
+	class Logger;
 }
 
 
@@ -26,8 +34,10 @@ namespace KEngineBasics {
 	class ButtonUpBinding;
 	class ButtonHoldBinding;
 	class CursorPositionBinding;
+	class ComboBinding;
 	class Input;
 	class InputForwarder;
+	class InputMapping;
 
 
 	enum ControllerType {
@@ -43,15 +53,94 @@ namespace KEngineBasics {
 		Vertical
 	};
 
+	enum InputEventType {
+		AxisChangeEvent,
+		ButtonDownEvent,
+		ButtonUpEvent,
+		CursorPositionEvent
+	};
+
+	// A raw event as it would be passed to one of the Input::Handle* methods, for batched submission.
+	struct InputEvent
+	{
+		InputEventType		mType;
+		ControllerType		mControllerType;
+		int					mId{ 0 };		// axis or button id, unused for cursors
+		float				mValue{ 0.0f };	// axis position
+		KEngine2D::Point	mPosition{ 0.0, 0.0 };	// cursor position
+		int					mDevice{ 0 };	// instance of the controller type, when several are connected
+		std::chrono::steady_clock::time_point	mTimestamp{};	// ingestion time; stamped on arrival if left unset
+	};
+
+	// Flags controlling how events received while Input is paused are merged in the pause journal.
+	enum PauseCoalescing {
+		PauseCoalesceNone			= 0,
+		PauseCoalesceContinuous		= 1 << 0,	// keep only the latest update of each axis and cursor
+		PauseCoalesceButtonPairs	= 1 << 1	// a button down and up (or up and down) of the same button cancel out
+	};
+
+	// How a CursorPositionBinding hears about motion.  Per-frame bindings are called once per Input::Flush,
+	// with the latest position, and only if the cursor moved; the raw samples behind that update are kept
+	// (with timestamps) for bindings that ask for history.
+	enum CursorDelivery {
+		CursorDeliverEachEvent,
+		CursorDeliverPerFrame,
+		CursorDeliverPerFrameWithHistory
+	};
+
+	struct CursorSample
+	{
+		KEngine2D::Point						mPosition;
+		std::chrono::steady_clock::time_point	mTimestamp;
+	};
+
+	// Handle to a binding's slot in its Input::BindingGroup.  The generation is bumped every time the slot
+	// is vacated, so a stale handle can never remove (or be mistaken for) a binding that reused its slot.
+	struct BindingHandle
+	{
+		static constexpr uint32_t InvalidIndex = UINT32_MAX;
+
+		uint32_t	mIndex{ InvalidIndex };
+		uint32_t	mGeneration{ 0 };
+		uint32_t	mPlayer{ 0 };	// whose bindings the group belongs to
+	};
+
+	// Repeating callback for bindings, in place of a KEngineCore::Timeout of their own.  All repeaters with the
+	// same timer and frequency share one Timeout owned by Input and fire together in a single pass.  The first
+	// period is timed from Init, as a lone Timeout would be; the repeater then joins the shared phase, skipping
+	// a shared tick if need be, so that no two calls are ever closer than a period.
+	class InputRepeater
+	{
+	public:
+		InputRepeater();
+		~InputRepeater();
+		void Init(Input* inputSystem, KEngineCore::Timer* timer, float frequency, InlineFunction<void()> callback);
+		void Cancel();
+
+		void Fire();
+	private:
+		Input*					mInputSystem{ nullptr };
+		KEngineCore::Timer*		mTimer{ nullptr };
+		float					mFrequency{ 0.0f };
+		BindingHandle			mPosition;			// in its bucket, or in Input::mWaitingRepeaters while mWaiting
+		InlineFunction<void()>	mCallback;
+		KEngineCore::Timeout	mFirstPeriod;
+		uint64_t				mContextMask{ 0 };
+		bool					mWaiting{ false };	// in its first period, or parked while its context is inactive
+		bool					mParked{ false };
+		bool					mAligned{ true };	// false until the shared tick inside its first period is skipped
+		friend class Input;
+	};
+
 	class ButtonDownBinding
 	{
 	public:
 		ButtonDownBinding();
 		~ButtonDownBinding();
-		void Init(Input* inputSystem, KEngineCore::StringHash buttonName, std::function<void()> callback, std::function<void()> cancelCallback = nullptr, bool oneShot = false);
+		void Init(Input* inputSystem, KEngineCore::StringHash buttonName, InlineFunction<void()> callback, InlineFunction<void()> cancelCallback = nullptr, bool oneShot = false);
 		void Deinit();
 
-		typedef std::list<ButtonDownBinding*>::iterator Position;
+		typedef BindingHandle Position;
 		void SetPosition(Position position);
 		Position GetPosition();
 
@@ -64,8 +153,8 @@ namespace KEngineBasics {
 		Input*					mInputSystem{ nullptr };
 		KEngineCore::StringHash mButtonName;
 		Position				mPosition;
-		std::function<void()>	mCallback;
-		std::function<void()>	mCancelCallback;
+		InlineFunction<void()>	mCallback;
+		InlineFunction<void()>	mCancelCallback;
 		bool					mOneShot;
 	};
 
@@ -74,10 +163,10 @@ namespace KEngineBasics {
 	public:
 		ButtonUpBinding();
 		~ButtonUpBinding();
-		void Init(Input* inputSystem, KEngineCore::StringHash buttonName, std::function<void()> callback, std::function<void()> cancelCallback = nullptr);
+		void Init(Input* inputSystem, KEngineCore::StringHash buttonName, InlineFunction<void()> callback, InlineFunction<void()> cancelCallback = nullptr);
 		void Deinit();
 
-		typedef std::list<ButtonUpBinding*>::iterator Position;
+		typedef BindingHandle Position;
 		void SetPosition(Position position);
 		Position GetPosition();
 
@@ -90,8 +179,8 @@ namespace KEngineBasics {
 		Input*					mInputSystem{ nullptr };
 		KEngineCore::StringHash	mButtonName;
 		Position				mPosition;
-		std::function<void()>	mCallback;
-		std::function<void()>	mCancelCallback;
+		InlineFunction<void()>	mCallback;
+		InlineFunction<void()>	mCancelCallback;
 	};
 
 	class ButtonHoldBinding
@@ -99,10 +188,10 @@ namespace KEngineBasics {
 	public:
 		ButtonHoldBinding();
 		~ButtonHoldBinding();
-		void Init(Input* inputSystem, KEngineCore::Timer* timer, KEngineCore::StringHash buttonName, float frequency, std::function<void()> callback, std::function<void()> cancelCallback = nullptr);
+		void Init(Input* inputSystem, KEngineCore::Timer* timer, KEngineCore::StringHash buttonName, float frequency, InlineFunction<void()> callback, InlineFunction<void()> cancelCallback = nullptr);
 		void Deinit();
 
-		typedef std::list<ButtonHoldBinding*>::iterator Position;
+		typedef BindingHandle Position;
 		void SetPosition(Position position);
 		Position GetPosition();
 
@@ -122,9 +211,9 @@ namespace KEngineBasics {
 		KEngineCore::StringHash	mButtonName;
 		Position				mPosition;
 		float					mFrequency{ 0.0f };
-		KEngineCore::Timeout	mTimeout;
-		std::function<void()>	mCallback{ nullptr };
-		std::function<void()>	mCancelCallback{ nullptr };
+		InputRepeater			mRepeater;
+		InlineFunction<void()>	mCallback{ nullptr };
+		InlineFunction<void()>	mCancelCallback{ nullptr };
 		bool					mButtonIsDown{ false };
 		bool					mButtonIsReady{ true };
 		ButtonDownBinding		mButtonDown;
@@ -136,14 +225,20 @@ namespace KEngineBasics {
 	public:
 		CursorPositionBinding();
 		~CursorPositionBinding();
-		void Init(Input* inputSystem, KEngineCore::StringHash controlName, std::function<void(const KEngine2D::Point&)> callback, std::function<void()> cancelCallback = nullptr);
+		void Init(Input* inputSystem, KEngineCore::StringHash controlName, InlineFunction<void(const KEngine2D::Point&)> callback, InlineFunction<void()> cancelCallback = nullptr, CursorDelivery delivery = CursorDeliverEachEvent);
 		void Deinit();
 
-		typedef std::list<CursorPositionBinding*>::iterator Position;
+		typedef BindingHandle Position;
 		void SetPosition(Position position);
 		Position GetPosition();
 
 		KEngineCore::StringHash GetControlName() const;
+		CursorDelivery GetDelivery() const;
+
+		// For per-frame bindings, from inside the callback: every sample of the frame (history bindings only)
+		// and the relative motion over the frame.
+		std::span<const CursorSample> GetSamples() const;
+		KEngine2D::Point GetDelta() const;
 
 		void UpdateCursor(const KEngine2D::Point& point);
 	private:
@@ -153,8 +248,20 @@ namespace KEngineBasics {
 		Input* mInputSystem{ nullptr };
 		Position										mPosition;
 		KEngineCore::StringHash							mControlName;
-		std::function<void(const KEngine2D::Point&)>	mCallback;
-		std::function<void()>							mCancelCallback;
+		InlineFunction<void(const KEngine2D::Point&)>	mCallback;
+		InlineFunction<void()>							mCancelCallback;
+		CursorDelivery									mDelivery{ CursorDeliverEachEvent };
+	};
+
+	// Conditioning of an axis's raw values, applied once per value before polled state or any binding sees
+	// it.  Forwarders still get the raw value, so recordings replay through the same processing.
+	struct AxisProcessing
+	{
+		float	mDeadZone{ 0.0f };		// smaller magnitudes read 0, and the rest is rescaled to fill 0..1
+		bool	mRadial{ false };		// for combined axes: the dead zone applies to the stick's length, not each axis
+		float	mExponent{ 1.0f };		// response curve, magnitude^exponent
+		float	mSmoothing{ 0.0f };		// 0..1, how much of the previous value each update keeps
+		bool	mInverted{ false };
 	};
 
 	struct VirtualAxisDescription
@@ -167,15 +274,17 @@ namespace KEngineBasics {
 		auto operator<=>(const VirtualAxisDescription&) const = default;
 	};
 
+	// Listener on a virtual axis.  Input evaluates each virtual axis once per player, from its converting
+	// button and cursor, and passes the value to every binding on it.
 	class VirtualAxisBinding
 	{
 	public:
 		VirtualAxisBinding();
 		~VirtualAxisBinding();
-		void Init(Input* inputSystem, KEngineCore::StringHash controlName, std::function<void(float)> callback, std::function<void()> cancelCallback = nullptr);
+		void Init(Input* inputSystem, KEngineCore::StringHash controlName, InlineFunction<void(float)> callback, InlineFunction<void()> cancelCallback = nullptr);
 		void Deinit();
 
-		typedef std::list<VirtualAxisBinding*>::iterator Position;
+		typedef BindingHandle Position;
 		void SetPosition(Position position);
 		Position GetPosition();
 
@@ -188,19 +297,10 @@ namespace KEngineBasics {
 
 		Input* mInputSystem{ nullptr };
 		KEngineCore::StringHash		mControlName;
-		std::function<void(float)>	mCallback;
-		std::function<void()>		mCancelCallback;
+		InlineFunction<void(float)>	mCallback;
+		InlineFunction<void()>		mCancelCallback;
 		Position					mPosition;
-
-		VirtualAxisDescription		mDescription;
-		float						mStartPosition;
-		float						mCurrentPosition;
-		bool						mActive{ false };
-
-		ButtonDownBinding mConvertingDown;
-		ButtonUpBinding mConvertingUp;
-
-		CursorPositionBinding mCursorPositionChanged;
+		friend class Input;
 	};
 
 	class AxisBinding
@@ -208,10 +308,12 @@ namespace KEngineBasics {
 	public:
 		AxisBinding();
 		~AxisBinding();
-		void Init(Input* inputSystem, KEngineCore::Timer* timer, KEngineCore::StringHash controlName, float deadZone, float frequency, std::function<void(float)> callback, std::function<void()> cancelCallback = nullptr);
+		// A frequency of zero reports every change of the axis as it happens instead of repeating.  The dead zone
+		// only decides when repeating starts and stops; shaping the value is Input::SetAxisProcessing's job.
+		void Init(Input* inputSystem, KEngineCore::Timer* timer, KEngineCore::StringHash controlName, float deadZone, float frequency, InlineFunction<void(float)> callback, InlineFunction<void()> cancelCallback = nullptr);
 		void Deinit();
 
-		typedef std::list<AxisBinding*>::iterator Position;
+		typedef BindingHandle Position;
 		void SetPosition(Position position);
 		Position GetPosition();
 
@@ -230,8 +332,8 @@ namespace KEngineBasics {
 		Position					mPosition;
 		float						mDeadZone;
 		float						mFrequency;
-		std::function<void(float)>	mCallback;
-		std::function<void()>		mCancelCallback;
+		InlineFunction<void(float)>	mCallback;
+		InlineFunction<void()>		mCancelCallback;
 
 		ButtonDownBinding			mNegativeDown;
 		ButtonUpBinding				mNegativeUp;
@@ -243,7 +345,7 @@ namespace KEngineBasics {
 
 		float						mLastTilt{ 0.0f };
 		bool						mDead{ true };
-		KEngineCore::Timeout		mTimeout;
+		InputRepeater				mRepeater;
 	};
 
 	class CombinedAxisBinding
@@ -251,10 +353,10 @@ namespace KEngineBasics {
 	public:
 		CombinedAxisBinding();
 		~CombinedAxisBinding(); 
-		void Init(Input* inputSystem, KEngineCore::Timer* timer, KEngineCore::StringHash controlName, float deadZone, float frequency, std::function<void(const KEngine2D::Point&)> callback, std::function<void()> cancelCallback = nullptr);
+		void Init(Input* inputSystem, KEngineCore::Timer* timer, KEngineCore::StringHash controlName, float deadZone, float frequency, InlineFunction<void(const KEngine2D::Point&)> callback, InlineFunction<void()> cancelCallback = nullptr);
 		void Deinit();
 
-		typedef std::list<CombinedAxisBinding*>::iterator Position;
+		typedef BindingHandle Position;
 		void SetPosition(Position position);
 		Position GetPosition();
 
@@ -273,24 +375,180 @@ namespace KEngineBasics {
 		Position										mPosition;
 		float											mDeadZone;
 		float											mFrequency;
-		std::function<void(const KEngine2D::Point&)>	mCallback;
-		std::function<void()>							mCancelCallback;
+		InlineFunction<void(const KEngine2D::Point&)>	mCallback;
+		InlineFunction<void()>							mCancelCallback;
+
+		void UpdateTilt();
+		bool IsInDeadZone() const;
 
 		AxisBinding	mHorizontalAxisBinding;
 		AxisBinding	mVerticalAxisBinding;
 
 		KEngine2D::Point		mLastTilt;
 		bool					mDead{ true };
-		KEngineCore::Timeout	mTimeout;
+		InputRepeater			mRepeater;
+	};
+
+	// One step of a combo: a single button, or a chord of buttons that must all be held, having been pressed
+	// within the chord window of each other.  mMaxDelay is the most time allowed since the previous step.
+	struct ComboStep
+	{
+		std::vector<KEngineCore::StringHash>	mButtons;
+		float									mMaxDelay{ 0.25f };
+	};
+
+	class ComboBinding
+	{
+	public:
+		ComboBinding();
+		~ComboBinding();
+		void Init(Input* inputSystem, KEngineCore::StringHash comboName, InlineFunction<void()> callback, InlineFunction<void()> cancelCallback = nullptr);
+		void Deinit();
+
+		typedef BindingHandle Position;
+		void SetPosition(Position position);
+		Position GetPosition();
+
+		KEngineCore::StringHash GetComboName() const;
+
+		void Fire();
+		void Cancel();
+		static const char MetaName[];
+	private:
+		Input*					mInputSystem{ nullptr };
+		KEngineCore::StringHash	mComboName;
+		Position				mPosition;
+		InlineFunction<void()>	mCallback;
+		InlineFunction<void()>	mCancelCallback;
+	};
+
+	// Dense index of a registered button, axis or cursor into the arrays of an InputState.
+	typedef uint32_t ControlIndex;
+	static constexpr ControlIndex InvalidControlIndex = UINT32_MAX;
+
+	// A control name resolved once to its state indices, for callers (such as Lua) that would otherwise hash
+	// and look the name up on every poll.  Owned by Input, and valid until Input::Deinit.
+	struct InputControlHandle
+	{
+		KEngineCore::StringHash	mName;
+		ControlIndex			mButton{ InvalidControlIndex };
+		ControlIndex			mAxis{ InvalidControlIndex };
+		ControlIndex			mCursor{ InvalidControlIndex };
+	};
+
+	// Snapshot of every registered control, for code that polls instead of binding.  Resolve names to
+	// indices once with Input::GetButtonIndex / GetAxisIndex / GetCursorIndex; each query is then a load or two.
+	class InputState
+	{
+	public:
+		inline bool IsDown(ControlIndex button) const {
+			return (mDown[button >> 6] >> (button & 63)) & 1;
+		}
+		// Edges are relative to the previous call to Input::SwapStateBuffers.
+		inline bool WasPressed(ControlIndex button) const {
+			return (mPressed[button >> 6] >> (button & 63)) & 1;
+		}
+		inline bool WasReleased(ControlIndex button) const {
+			return (mReleased[button >> 6] >> (button & 63)) & 1;
+		}
+		inline float GetAxis(ControlIndex axis) const {
+			return mAxes[axis];
+		}
+		inline const KEngine2D::Point& GetCursor(ControlIndex cursor) const {
+			return mCursors[cursor];
+		}
+	private:
+		void Resize(size_t buttonCount, size_t axisCount, size_t cursorCount);
+		void SetButton(ControlIndex button, bool down);
+		void CarryOver(const InputState& previous);
+
+		std::vector<uint64_t>			mDown;
+		std::vector<uint64_t>			mPressed;
+		std::vector<uint64_t>			mReleased;
+		std::vector<float>				mAxes;
+		std::vector<KEngine2D::Point>	mCursors;
+		friend class Input;
 	};
 
+	// Time from an event's ingestion to the work it caused, in the same buckets as the callback histogram.
+	struct InputLatencyHistogram
+	{
+		uint64_t	mCount{ 0 };
+		uint64_t	mNanoseconds{ 0 };
+		uint64_t	mMaxNanoseconds{ 0 };
+		uint64_t	mHistogram[32]{};
+
+		void Record(uint64_t nanoseconds);
+	};
+
+	// Ingestion is the first of Handle*, SubmitEvent or PostEvent to see the event, and the stamp is carried
+	// through batching, the posted event queue and the pause journal (so time spent paused counts).
+	struct InputLatency
+	{
+		InputLatencyHistogram	mCallback;		// to each binding callback it fires
+		InputLatencyHistogram	mLuaResume;		// to a Lua thread waiting on it (input.waitForButtonDown) running again
+	};
+
+	// Hot-path counters, collected only when built with KENGINE_INPUT_INSTRUMENTATION (the CMake option
+	// KENGINE_BASICS_INPUT_INSTRUMENTATION).  Without it every hook compiles away and these stay zero.
+	// Callback times are inclusive, so a binding whose callback dispatches further input counts that too.
+	struct InputStatistics
+	{
+		static constexpr int CallbackHistogramBuckets = 32;
+
+		uint64_t				mEventCounts[CursorPositionEvent + 1]{};	// dispatched events, by InputEventType
+		uint64_t				mUnmappedEvents{ 0 };						// events with no registered control
+		std::vector<uint64_t>	mButtonEventCounts;							// by ControlIndex, downs and ups
+		std::vector<uint64_t>	mAxisEventCounts;
+		std::vector<uint64_t>	mCursorEventCounts;
+
+		uint64_t				mBindingsVisited{ 0 };
+		uint64_t				mMaxBindingsVisitedPerEvent{ 0 };
+
+		uint64_t				mCallbackCount{ 0 };
+		uint64_t				mCallbackNanoseconds{ 0 };
+		uint64_t				mMaxCallbackNanoseconds{ 0 };
+		uint64_t				mCallbackHistogram[CallbackHistogramBuckets]{};	// bucket i: [2^i, 2^(i+1)) ns, bucket 0 also holds 0
+
+		InputLatency			mLatency;
+	};
+
+	// Bounded lock-free multi-producer, single-consumer queue of InputEvents, used to hand events from OS or
+	// device threads to the game thread.  Each cell carries a sequence number that tells producers and the
+	// consumer whose turn it is, so neither side ever takes a lock.  Capacity is rounded up to a power of two.
+	class ConcurrentInputEventQueue
+	{
+	public:
+		ConcurrentInputEventQueue();
+		~ConcurrentInputEventQueue();
+		void Init(size_t capacity);
+		void Deinit();
+
+		bool Push(const InputEvent& event);	// any thread; false (and counted) when the queue is full
+		bool Pop(InputEvent& event);		// consumer thread only
+
+		size_t GetCapacity() const;
+		size_t GetOverflowCount() const;
+	private:
+		struct Cell
+		{
+			std::atomic<size_t>	mSequence;
+			InputEvent			mEvent;
+		};
+
+		std::unique_ptr<Cell[]>		mCells;
+		size_t						mMask{ 0 };
+		alignas(64) std::atomic<size_t>	mEnqueuePosition{ 0 };
+		alignas(64) std::atomic<size_t>	mDequeuePosition{ 0 };
+		alignas(64) std::atomic<size_t>	mOverflows{ 0 };
+	};
 
 	class Input
 	{
 	public:
 		Input();
 		~Input();
-		void Init(KEngineCore::LuaScheduler* scheduler, KEngineCore::Timer* timer);
+		void Init(KEngineCore::LuaScheduler* scheduler, KEngineCore::Timer* timer, KEngineCore::Logger* logger = nullptr);
 		void Deinit();
 
 		void AddCombinedAxis(KEngineCore::StringHash name);
@@ -300,6 +558,39 @@ namespace KEngineBasics {
 		void AddButton(KEngineCore::StringHash name, ControllerType controllerType, int id);
 		void AddCursor(KEngineCore::StringHash name, ControllerType controllerType);
 		void AddVirtualAxis(KEngineCore::StringHash axisName, KEngineCore::StringHash convertedCursorName, AxisType axisType, KEngineCore::StringHash buttonName, float conversionFactor);
+		// Registers every control of a compiled mapping table in one pass (see InputMapping).
+		void AddMappings(const InputMapping& mapping);
+		// Combos are matched by one automaton, advanced once per button down, so each event costs the same
+		// however many combos are registered.  Unrelated presses between steps don't break a combo.
+		void AddCombo(KEngineCore::StringHash name, std::span<const ComboStep> steps);
+		void SetComboChordWindow(float seconds);
+		// Set on a combined axis, processing applies to both child axes, so call it after adding them.
+		void SetAxisProcessing(KEngineCore::StringHash axisName, const AxisProcessing& processing);
+
+		// Input contexts (gameplay, menu, dialog...).  Bindings belong to the binding context current when they
+		// are Init'ed, and only fire while it is active: on the context stack, enabled, and not below a blocking
+		// context.  Changing any of that only recomputes a mask, so no binding is torn down or rebuilt.  The
+		// "default" context is registered by Init and sits permanently at the bottom of the stack.
+		void AddContext(KEngineCore::StringHash name, bool blocking = false);
+		bool HasContext(KEngineCore::StringHash name) const;
+		void PushContext(KEngineCore::StringHash name);
+		void PopContext(KEngineCore::StringHash name);
+		void SetContextEnabled(KEngineCore::StringHash name, bool enabled);
+		bool IsContextActive(KEngineCore::StringHash name) const;
+		void SetBindingContext(KEngineCore::StringHash name);
+		KEngineCore::StringHash GetBindingContext() const;
+
+		// Local multiplayer.  Every device instance belongs to a player (player 0 until assigned), and every
+		// player has its own bindings, polled state and combo progress over the shared mappings.  Events go
+		// straight from their device to that player's dispatch table, so a busy session costs no more per
+		// event than a single player does.  Bindings belong to the binding player current when they are Init'ed.
+		static constexpr int MaxPlayers = 8;
+		void AssignDevice(ControllerType controllerType, int device, int player);
+		int GetDevicePlayer(ControllerType controllerType, int device) const;
+		void SetBindingPlayer(int player);
+		int GetBindingPlayer() const;
+		int GetEventDevice() const;	// device of the event being dispatched, for bindings and forwarders
+		std::chrono::steady_clock::time_point GetEventTimestamp() const;	// its ingestion time, likewise
 
 		void AddCombinedAxisBinding(CombinedAxisBinding* binding);
 		void AddAxisBinding(AxisBinding* binding);
@@ -308,6 +599,7 @@ namespace KEngineBasics {
 		void AddButtonHoldBinding(ButtonHoldBinding* binding);
 		void AddButtonUpBinding(ButtonUpBinding* binding);
 		void AddCursorPositionBinding(CursorPositionBinding* binding);
+		void AddComboBinding(ComboBinding* binding);
 
 		bool RemoveCombinedAxisBinding(CombinedAxisBinding* binding);
 		bool RemoveAxisBinding(AxisBinding* binding);
@@ -316,11 +608,26 @@ namespace KEngineBasics {
 		bool RemoveButtonUpBinding(ButtonUpBinding* binding);
 		bool RemoveButtonHoldBinding(ButtonHoldBinding* binding);
 		bool RemoveCursorPositionBinding(CursorPositionBinding* binding);
-
-		void HandleAxisChange(ControllerType type, int axisId, float axisPosition);
-		void HandleButtonDown(ControllerType type, int buttonId);
-		void HandleButtonUp(ControllerType type, int buttonId);
-		void HandleCursorPosition(ControllerType type, const KEngine2D::Point& position);
+		bool RemoveComboBinding(ComboBinding* binding);
+
+		void HandleAxisChange(ControllerType type, int axisId, float axisPosition, int device = 0, std::chrono::steady_clock::time_point timestamp = {});
+		void HandleButtonDown(ControllerType type, int buttonId, int device = 0, std::chrono::steady_clock::time_point timestamp = {});
+		void HandleButtonUp(ControllerType type, int buttonId, int device = 0, std::chrono::steady_clock::time_point timestamp = {});
+		void HandleCursorPosition(ControllerType type, const KEngine2D::Point& position, int device = 0, std::chrono::steady_clock::time_point timestamp = {});
+
+		// Batched alternative to the Handle* methods above.  Submitted events are held until Flush, which
+		// dispatches them in submission order, except that only the latest update to each axis and cursor
+		// survives (placed where that latest update arrived).  Button downs and ups are never coalesced.
+		void HandleEvent(const InputEvent& event);
+		void SubmitEvent(const InputEvent& event);
+		void SubmitEvents(std::span<const InputEvent> events);
+		// Also the frame boundary for per-frame cursor bindings, so call it once per frame even when not batching.
+		void Flush();
+
+		// Samples and relative motion of a cursor over the frame ending at the last Flush.  Samples are only
+		// kept while some binding on the cursor uses CursorDeliverPerFrameWithHistory.
+		std::span<const CursorSample> GetCursorSamples(KEngineCore::StringHash cursorName, int player = 0) const;
+		KEngine2D::Point GetCursorDelta(KEngineCore::StringHash cursorName, int player = 0) const;
 
 		bool HasCombinedAxis(KEngineCore::StringHash name) const;
 		bool HasChildAxis(KEngineCore::StringHash parentName, AxisType axisType) const;
@@ -329,6 +636,7 @@ namespace KEngineBasics {
 		bool HasVirtualAxis(KEngineCore::StringHash name) const;
 		bool HasAxisButton(KEngineCore::StringHash parentName, int direction) const;
 		bool HasButton(KEngineCore::StringHash name) const;
+		bool HasCombo(KEngineCore::StringHash name) const;
 
 		KEngineCore::StringHash GetAxisForCombinedAxis(KEngineCore::StringHash combinedAxisName, AxisType axisType) const;
 		KEngineCore::StringHash GetButtonForAxis(KEngineCore::StringHash AxisName, int direction) const;
@@ -340,8 +648,40 @@ namespace KEngineBasics {
 		void AddInputForwarder(InputForwarder* forwarder);
 		void RemoveInputForwarder(InputForwarder* forwarder);
 
+		// While paused, events are recorded in a fixed-size journal and replayed in arrival order on Resume.
+		// When the journal is full, entries cancelled by coalescing are reclaimed first, then the oldest axis or
+		// cursor update is dropped and counted as an overflow.  Button downs and ups are never dropped: a
+		// journal holding nothing else grows for them, and refuses (and counts) axis and cursor updates.
 		void Pause();
 		void Resume();
+		void SetPauseJournalCapacity(size_t capacity);
+		void SetPauseCoalescing(int pauseCoalescingFlags);
+		size_t GetPauseJournalOverflowCount() const;
+
+		// Thread-safe ingestion: any thread may PostEvent, and the game thread calls DrainPostedEvents once per
+		// frame to feed them into dispatch, either immediately or into the SubmitEvent batch.
+		void SetPostedEventCapacity(size_t capacity);
+		bool PostEvent(const InputEvent& event);
+		size_t DrainPostedEvents(bool batched = false);
+		size_t GetPostedEventOverflowCount() const;
+
+		// Polled state.  Events update a back buffer as they are dispatched; SwapStateBuffers (once per frame)
+		// publishes it as GetState and starts a new back buffer with the same held values and no edges.
+		const InputState& GetState(int player = 0) const;
+		void SwapStateBuffers();
+		ControlIndex GetButtonIndex(KEngineCore::StringHash name) const;
+		ControlIndex GetAxisIndex(KEngineCore::StringHash name) const;
+		ControlIndex GetCursorIndex(KEngineCore::StringHash name) const;
+		// Handle for a registered control, combo or context, made on first use; nullptr for any other name, so
+		// lookups of unknown names don't grow the registry.
+		const InputControlHandle* GetControlHandle(KEngineCore::StringHash name);
+		// The handle at pointer, or nullptr if pointer isn't a handle this Input gave out.  Never dereferences pointer.
+		const InputControlHandle* FindControlHandle(const void* pointer) const;
+
+		const InputStatistics& GetStatistics() const;
+		void ResetStatistics();
+		// Latency recorded over the frame ending at the last Flush, for checking per-frame budgets.
+		const InputLatency& GetFrameLatency() const;
 	private:
 
 		bool HasAxisMapping(ControllerType type, int axisId) const;
@@ -352,38 +692,281 @@ namespace KEngineBasics {
 		KEngineCore::StringHash GetButtonMapping(ControllerType type, int buttonId) const;
 		KEngineCore::StringHash GetCursorMapping(ControllerType type) const;
 
-		void HandleButonDownInternal(KEngineBasics::ControllerType type, int buttonId);
-		void HandleButtonUpInternal(KEngineBasics::ControllerType type, int buttonId);
-
+		// Slot map of bindings.  Vacated slots are threaded onto a free list and reused, so once a group has
+		// grown to its working size adding and removing bindings never allocates.  Callbacks may add and
+		// remove bindings while the group is being iterated.  Removal empties the slot at once, so a removed
+		// binding is never called.  Addition only reserves the slot (and the handle): the binding waits in
+		// mPendingAdds until the outermost pass over the group ends, so it first fires on the next event
+		// wherever its slot is.  A group nobody changes mid-pass pays only for the depth count.
 		template<typename BindingType>
 		struct BindingGroup
 		{
-			std::list<BindingType*>							mBindings;
-			BindingType* mProcessingBinding; //THIS ISN'T GETTING USED YET
-			std::vector<BindingType*>						mSelfClearedBindings;
-			inline void Cleanup() {
-				for (auto selfClearedBinding : mSelfClearedBindings)
+			static constexpr uint32_t PendingSlot = BindingHandle::InvalidIndex - 1;	// mNextFree of a reserved slot
+
+			struct Slot
+			{
+				BindingType*	mBinding{ nullptr };
+				uint32_t		mGeneration{ 0 };
+				uint32_t		mNextFree{ BindingHandle::InvalidIndex };
+				uint64_t		mContextMask{ 0 };	// the binding's input context, as a bit
+			};
+
+			struct PendingAdd
+			{
+				uint32_t		mIndex;
+				uint32_t		mGeneration;	// the add is dropped if the slot was vacated meanwhile
+				BindingType*	mBinding;
+			};
+
+			std::vector<Slot>		mSlots;
+			std::vector<PendingAdd>	mPendingAdds;	// kept at its working size, like mSlots
+			uint32_t				mFirstFree{ BindingHandle::InvalidIndex };
+			uint32_t				mIterationDepth{ 0 };
+
+			inline BindingHandle Add(BindingType* binding, uint64_t contextMask, uint32_t player = 0) {
+				uint32_t index = mFirstFree;
+				if (index != BindingHandle::InvalidIndex)
+				{
+					mFirstFree = mSlots[index].mNextFree;
+				}
+				else
+				{
+					index = (uint32_t)mSlots.size();
+					mSlots.emplace_back();
+				}
+				Slot& slot = mSlots[index];
+				slot.mContextMask = contextMask;
+				if (mIterationDepth == 0)
+				{
+					slot.mBinding = binding;
+					slot.mNextFree = BindingHandle::InvalidIndex;
+				}
+				else
+				{
+					slot.mBinding = nullptr;
+					slot.mNextFree = PendingSlot;
+					mPendingAdds.push_back({ index, slot.mGeneration, binding });
+				}
+				return { index, slot.mGeneration, player };
+			}
+
+			inline bool Contains(BindingHandle handle) const {
+				if (handle.mIndex >= mSlots.size())
+				{
+					return false;
+				}
+				const Slot& slot = mSlots[handle.mIndex];
+				return slot.mGeneration == handle.mGeneration && (slot.mBinding != nullptr || slot.mNextFree == PendingSlot);
+			}
+
+			inline bool Remove(BindingHandle handle) {
+				if (!Contains(handle))
+				{
+					return false;
+				}
+				Slot& slot = mSlots[handle.mIndex];
+				slot.mBinding = nullptr;
+				slot.mGeneration++;
+				slot.mNextFree = mFirstFree;
+				mFirstFree = handle.mIndex;
+				return true;
+			}
+
+			// Indexing (rather than iterating) tolerates mSlots growing as callbacks reserve slots.
+			template<typename Function>
+			inline void ForEach(Function&& function) {
+				mIterationDepth++;
+				for (size_t i = 0; i < mSlots.size(); i++)
+				{
+					BindingType* binding = mSlots[i].mBinding;
+					if (binding != nullptr)
+					{
+						function(binding);
+					}
+				}
+				EndIteration();
+			}
+
+			// As ForEach, but only bindings in one of the given contexts.
+			template<typename Function>
+			inline void ForEachActive(uint64_t activeContexts, Function&& function) {
+				mIterationDepth++;
+				for (size_t i = 0; i < mSlots.size(); i++)
+				{
+					BindingType* binding = mSlots[i].mBinding;
+					if (binding != nullptr && (mSlots[i].mContextMask & activeContexts) != 0)
+					{
+						function(binding, mSlots[i].mContextMask);
+					}
+				}
+				EndIteration();
+			}
+
+			inline void EndIteration() {
+				if (--mIterationDepth == 0 && !mPendingAdds.empty())
 				{
-					mBindings.erase(selfClearedBinding->GetPosition());
-					selfClearedBinding->SetPosition(mBindings.end());
+					for (const PendingAdd& add : mPendingAdds)
+					{
+						Slot& slot = mSlots[add.mIndex];
+						if (slot.mGeneration == add.mGeneration && slot.mNextFree == PendingSlot)
+						{
+							slot.mBinding = add.mBinding;
+							slot.mNextFree = BindingHandle::InvalidIndex;
+						}
+					}
+					mPendingAdds.clear();
 				}
-				mSelfClearedBindings.clear();
+			}
+
+			inline void Clear() {
+				mSlots.clear();
+				mPendingAdds.clear();
+				mFirstFree = BindingHandle::InvalidIndex;
 			}
 		};
 
+		// Every event dispatch goes through here rather than calling ForEach directly.  It skips bindings in
+		// inactive contexts, tracks the context of the binding being dispatched (so that repeaters it starts
+		// share it), and lets the instrumented build count and time each binding it visits.
+		template<typename BindingType, typename Function>
+		inline void Dispatch(BindingGroup<BindingType>& bindingGroup, Function&& function) {
+			uint64_t dispatchingContexts = mDispatchingContexts;
+			bindingGroup.ForEachActive(mActiveContexts, [&](BindingType* binding, uint64_t contextMask) {
+				mDispatchingContexts = contextMask;
+#ifdef KENGINE_INPUT_INSTRUMENTATION
+				mStatistics.mBindingsVisited++;
+				auto start = std::chrono::steady_clock::now();
+				RecordLatency(&InputLatency::mCallback, start);
+				function(binding);
+				RecordCallback(std::chrono::steady_clock::now() - start);
+#else
+				function(binding);
+#endif
+			});
+			mDispatchingContexts = dispatchingContexts;
+		}
+
+		struct InputContextDescription
+		{
+			KEngineCore::StringHash	mName;
+			bool					mBlocking{ false };
+			bool					mEnabled{ true };
+		};
+
+		static constexpr size_t MaxInputContexts = 64;
+
+		void UpdateActiveContexts();
+		uint32_t GetContextIndex(KEngineCore::StringHash name) const;
+		inline uint64_t GetBindingContextMask() const {
+			return 1ull << mBindingContext;
+		}
+
+		std::vector<InputContextDescription>	mContexts;			// indexed by context bit
+		std::map<KEngineCore::StringHash, uint32_t>	mContextIndices;
+		std::vector<uint32_t>					mContextStack;		// bottom first
+		uint64_t								mActiveContexts{ ~0ull };
+		uint64_t								mDispatchingContexts{ 0 };	// context of the binding being dispatched, 0 outside dispatch
+		uint32_t								mBindingContext{ 0 };
+
+#ifdef KENGINE_INPUT_INSTRUMENTATION
+		uint64_t BeginInstrumentedEvent(InputEventType type, ControlIndex index);
+		void EndInstrumentedEvent(uint64_t visitedBefore);
+		void RecordCallback(std::chrono::steady_clock::duration duration);
+		void RecordLatency(InputLatencyHistogram InputLatency::* histogram, std::chrono::steady_clock::time_point now);
+		void RecordLuaWake(lua_State* luaState);
+		void RecordLuaResume(lua_State* luaState);
+
+		// Ingestion time of the event that woke each waiting thread.  Only a handful wait at once, so a flat
+		// list, reserved up front so that waking a thread doesn't allocate.
+		struct PendingLuaResume
+		{
+			lua_State*								mThread;
+			std::chrono::steady_clock::time_point	mTimestamp;
+		};
+		std::vector<PendingLuaResume>	mPendingLuaResumes;
+		static constexpr size_t DefaultPendingLuaResumeCapacity = 16;
+#endif
+		InputStatistics						mStatistics;
+		InputLatency						mFrameLatency;		// being recorded
+		InputLatency						mLastFrameLatency;	// as of the last Flush
+
+		// A virtual axis as one player sees it.  The converting button and cursor of every player point at
+		// their channels, so dispatch updates each axis once, however many bindings listen to it.
+		struct VirtualAxisChannel
+		{
+			const VirtualAxisDescription*		mDescription{ nullptr };
+			BindingGroup<VirtualAxisBinding>	mBindings;
+			float								mStartPosition{ 0.0f };
+			float								mCurrentPosition{ 0.0f };
+			bool								mActive{ false };
+		};
+
 		struct ButtonBindingPack
 		{
 			BindingGroup<ButtonDownBinding> mButtonDownBindings;
 			BindingGroup<ButtonUpBinding> mButtonUpBindings;
 			BindingGroup<ButtonHoldBinding> mButtonHoldBindings;
+			std::vector<VirtualAxisChannel*> mVirtualAxes;	// converted by this button
+		};
+
+		// Everything kept per registered cursor.  Per-frame bindings live apart from the per-event ones, so
+		// motion events never visit them.  Samples and delta accumulate until Flush, which moves them to the
+		// mFrame* members and delivers.
+		struct CursorChannel
+		{
+			BindingGroup<CursorPositionBinding>	mEachEventBindings;
+			BindingGroup<CursorPositionBinding>	mPerFrameBindings;
+			size_t								mHistoryBindingCount{ 0 };
+			std::vector<CursorSample>			mSamples;
+			std::vector<CursorSample>			mFrameSamples;
+			KEngine2D::Point					mLatest{ 0.0, 0.0 };
+			KEngine2D::Point					mDelta{ 0.0, 0.0 };
+			KEngine2D::Point					mFrameDelta{ 0.0, 0.0 };
+			bool								mHasLatest{ false };
+			bool								mMoved{ false };
+			std::vector<VirtualAxisChannel*>	mVirtualAxes;	// converted from this cursor
 		};
 
-		BindingGroup<AxisBinding>& GetAxisBindings(KEngineCore::StringHash name);
-		ButtonBindingPack& GetButtonBindings(KEngineCore::StringHash name);
-		BindingGroup<CursorPositionBinding>& GetCursorBindings(KEngineCore::StringHash name);
+		static constexpr size_t MaxCursorSamplesPerFrame = 4096;
+
+		void RecordCursorSample(CursorChannel& channel, const KEngine2D::Point& position);
+		void RegisterVirtualAxis(KEngineCore::StringHash name, const VirtualAxisDescription& description);
+		void UpdateVirtualAxes(const CursorChannel& channel, const KEngine2D::Point& position);
+		void StartVirtualAxes(const ButtonBindingPack& bindingPack);
+		void StopVirtualAxes(const ButtonBindingPack& bindingPack);
+		void DeliverCursorFrames();
+
+		// Flattened view of the mappings, resolved straight to the binding groups so that dispatch
+		// never has to walk the mapping or binding trees.  Rebuilt lazily after AddButton/AddAxis/AddCursor.
+		struct ControlDispatch
+		{
+			ButtonBindingPack*			mButtonBindings{ nullptr };
+			BindingGroup<AxisBinding>*	mAxisBindings{ nullptr };
+			ControlIndex				mButtonIndex{ InvalidControlIndex };
+			ControlIndex				mAxisIndex{ InvalidControlIndex };
+		};
+
+		struct ControllerDispatchTable
+		{
+			std::vector<ControlDispatch>					mDenseControls;		// indexed by id + 1, so id -1 ("any") is slot 0
+			std::vector<std::pair<int, ControlDispatch>>	mSparseControls;	// sorted by id, for ids above MaxDenseControlId
+			CursorChannel*									mCursorChannel{ nullptr };
+			ControlIndex									mCursorIndex{ InvalidControlIndex };
+
+			const ControlDispatch* Find(int id) const;
+			ControlDispatch& Insert(int id);
+		};
+
+		static constexpr int ControllerTypeCount = ControllerType::Virtual + 1;
+		static constexpr int MaxDenseControlId = 1023;
+
+		void RebuildDispatchTables();
+
+		bool								mDispatchTablesDirty{ false };
 
 		KEngineCore::LuaScheduler* mScheduler{ nullptr };
 		KEngineCore::Timer* mTimer{ nullptr };
+		KEngineCore::Logger* mLogger{ nullptr };
 
 		std::set<KEngineCore::StringHash>	mCombinedAxes;
 		std::set<KEngineCore::StringHash>	mAxes;
@@ -404,32 +987,276 @@ namespace KEngineBasics {
 
 		std::map<ControllerType, KEngineCore::StringHash>				mCursorMappings;
 				
-		std::map<KEngineCore::StringHash, ButtonBindingPack> mButtonBindings;
-		std::map<KEngineCore::StringHash, BindingGroup<AxisBinding>> mAxisBindings;
-		std::map<KEngineCore::StringHash, BindingGroup<CursorPositionBinding>> mCursorPositionBindings;
 		BindingGroup<CombinedAxisBinding>	mCombinedAxisBindings;
-		BindingGroup<VirtualAxisBinding>	mVirtualAxisBindings;
 
 		std::list<InputForwarder*>			mForwarders;
 
+		// Combo automaton: a trie of steps, shared between combos with a common prefix.  Node 0 is the root.
+		// Each edge is listed once per button of its chord, sorted by that trigger button, and fires when the
+		// trigger press completes the chord.  Rebuilt lazily after AddCombo.
+		struct ComboDefinition
+		{
+			KEngineCore::StringHash	mName;
+			std::vector<ComboStep>	mSteps;
+		};
+
+		struct ComboNode
+		{
+			uint32_t							mFirstEdge{ 0 };
+			uint32_t							mEdgeCount{ 0 };
+			float								mMaxDelay{ 0.0f };		// longest delay of any outgoing edge
+			uint32_t							mCombo{ NoCombo };		// index of the definition that ends here
+		};
+
+		static constexpr uint32_t NoCombo = UINT32_MAX;
+
+		struct ComboEdge
+		{
+			ControlIndex	mTrigger;
+			uint32_t		mFirstChordButton;
+			uint32_t		mChordSize;
+			float			mMaxDelay;
+			uint32_t		mTarget;
+		};
+
+		// A node some recent presses have reached, and when.
+		struct ComboPartial
+		{
+			uint32_t								mNode;
+			std::chrono::steady_clock::time_point	mReached;
+			bool									mCompleted;	// a combo ended here on this press
+		};
+
+		std::vector<ComboDefinition>							mComboDefinitions;
+		std::vector<ComboNode>									mComboNodes;
+		std::vector<ComboEdge>									mComboEdges;
+		std::vector<ControlIndex>								mComboChordButtons;
+		std::vector<ComboPartial>								mNextComboPartials;
+		std::vector<BindingGroup<ComboBinding>*>				mCompletedCombos;
+		float													mComboChordWindow{ 0.05f };
+		bool													mCombosDirty{ false };
+
+		// Everything a player owns.  Each player's dispatch tables resolve the shared mappings to that
+		// player's binding groups.
+		struct PlayerInput
+		{
+			std::map<KEngineCore::StringHash, ButtonBindingPack>			mButtonBindings;
+			std::map<KEngineCore::StringHash, BindingGroup<AxisBinding>>	mAxisBindings;
+			std::map<KEngineCore::StringHash, CursorChannel>				mCursorChannels;
+			std::map<KEngineCore::StringHash, BindingGroup<ComboBinding>>	mComboBindings;
+			std::map<KEngineCore::StringHash, VirtualAxisChannel>			mVirtualAxes;
+			ControllerDispatchTable									mDispatchTables[ControllerTypeCount];
+			InputState												mStates[2];
+			std::vector<ComboPartial>								mComboPartials;
+			std::vector<std::chrono::steady_clock::time_point>		mComboPressTimes;	// by ControlIndex
+			std::vector<float>										mRawAxes;			// by ControlIndex, before processing
+		};
+
+		inline PlayerInput& GetEventPlayer(ControllerType type, int device) {
+			const std::vector<uint8_t>& devicePlayers = mDevicePlayers[type];
+			return mPlayers[(device >= 0 && (size_t)device < devicePlayers.size()) ? devicePlayers[device] : 0];
+		}
+
+		inline const ControllerDispatchTable& GetDispatchTable(PlayerInput& player, ControllerType type) {
+			if (mDispatchTablesDirty)
+			{
+				RebuildDispatchTables();
+			}
+			return player.mDispatchTables[type];
+		}
+
+		inline InputState& GetBackState(PlayerInput& player) {
+			return player.mStates[mFrontState ^ 1];
+		}
+
+		BindingGroup<AxisBinding>& GetAxisBindings(PlayerInput& player, KEngineCore::StringHash name);
+		ButtonBindingPack& GetButtonBindings(PlayerInput& player, KEngineCore::StringHash name);
+		CursorChannel& GetCursorChannel(PlayerInput& player, KEngineCore::StringHash name);
+		void UsePlayer(int player);
+		void DispatchAxisChange(PlayerInput& player, const ControlDispatch* control, ControllerType type, int axisId, float axisPosition, float processedPosition, int device, std::chrono::steady_clock::time_point timestamp);
+		void HandleButonDownInternal(PlayerInput& player, const ControlDispatch* control);
+		void HandleButtonUpInternal(PlayerInput& player, const ControlDispatch* control);
+
+		void RebuildComboAutomaton();
+		void AdvanceCombos(PlayerInput& player, ControlIndex button);
+		bool IsComboChordComplete(const PlayerInput& player, const ComboEdge& edge, std::chrono::steady_clock::time_point now) const;
+
+		PlayerInput								mPlayers[MaxPlayers];
+		int										mPlayerCount{ 1 };	// players that have been assigned devices or bindings
+		std::vector<uint8_t>					mDevicePlayers[ControllerTypeCount];	// by device
+		uint32_t								mBindingPlayer{ 0 };
+		int										mEventDevice{ 0 };
+		std::chrono::steady_clock::time_point	mEventTimestamp{};
+
 		bool								mPaused { false };
 		
 		struct ControlID
 		{
 			ControllerType	type;
 			int				id;
+			int				device;
 
 			bool operator<(const ControlID& r) const {
-				return (type < r.type || (type == r.type && id < r.id));
+				return (type < r.type || (type == r.type && (id < r.id || (id == r.id && device < r.device))));
 			}
 		};
 		
-		std::map<ControlID, int>					mQueuedAxisUpdates;
-		std::set<ControlID>							mQueuedButtonDowns;
-		std::set<ControlID>							mQueuedButtonUps;
-		std::map<ControllerType, KEngine2D::Point>	mQueuedCursorUpdates;
+		struct BatchedEvent
+		{
+			InputEvent	mEvent;
+			bool		mLive;
+			bool		mProcessed{ false };	// set by ProcessBatchedAxes
+			float		mProcessedValue{ 0.0f };
+		};
+
+		std::vector<BatchedEvent>	mBatchedEvents;
+		std::vector<BatchedEvent>	mFlushingEvents;
+		std::vector<size_t>			mBatchedContinuousEvents;	// indices of the live axis and cursor events in mBatchedEvents
+
+		// Axis processing, by ControlIndex.  The per-event path conditions one value at a time; Flush gathers
+		// every axis value in the batch into the parallel arrays of AxisBatch and conditions them in one loop.
+		struct AxisConditioning
+		{
+			float			mDeadZone{ 0.0f };
+			float			mExponent{ 1.0f };
+			float			mScale{ 1.0f };		// -1 when inverted
+			float			mSmoothing{ 0.0f };
+			ControlIndex	mPartner{ InvalidControlIndex };	// other axis of a radial pair
+			bool			mEnabled{ false };
+		};
+
+		struct AxisBatch
+		{
+			std::vector<size_t>	mEvents;	// indices into mFlushingEvents
+			std::vector<float>	mRaw;
+			std::vector<float>	mPartnerRaw;
+			std::vector<float>	mDeadZone;
+			std::vector<float>	mExponent;
+			std::vector<float>	mScale;
+			std::vector<float>	mSmoothing;
+			std::vector<float>	mPrevious;
+			std::vector<float>	mProcessed;
+		};
+
+		void SetAxisConditioning(ControlIndex axis, const AxisProcessing& processing, ControlIndex partner);
+		float ProcessAxis(PlayerInput& player, ControlIndex axis, float axisPosition);
+		void ProcessBatchedAxes();
+
+		std::vector<AxisConditioning>	mAxisConditioning;
+		AxisBatch						mAxisBatch;
+
+		struct JournaledEvent
+		{
+			InputEvent	mEvent;
+			bool		mLive;
+		};
+
+		// Newest journal entry for a control, so coalescing never has to scan the journal itself.  Kept in an
+		// open-addressed table of at least twice the journal's capacity; a slot is in use while its generation
+		// is current, so emptying the table is one increment.
+		struct JournaledControl
+		{
+			ControlID	mControl;
+			uint64_t	mSequence{ 0 };
+			uint32_t	mGeneration{ 0 };
+			uint8_t		mKind{ 0 };		// JournalKind
+		};
+
+		void JournalEvent(const InputEvent& event);
+		bool MakeJournalRoom(bool continuous);
+		void CompactPauseJournal(bool evictContinuous);
+		void GrowPauseJournal();
+		void ClearPauseJournal();
+		JournaledControl& ProbeJournaledControl(const InputEvent& event);
+		void SetJournaledControl(JournaledControl& journaledControl, const InputEvent& event, uint64_t sequence);
+		void RebuildJournaledControls(size_t size);
+		inline JournaledEvent& GetJournaledEvent(uint64_t sequence) {
+			return mPauseJournal[sequence % mPauseJournal.size()];
+		}
+
+		std::vector<JournaledEvent>		mPauseJournal;		// ring buffer, entries addressed by sequence number
+		std::vector<InputEvent>			mReplayingJournal;	// spare buffer for Resume, kept for its capacity
+		std::vector<JournaledControl>	mJournaledControls;	// power-of-two size
+		size_t							mJournaledControlCount{ 0 };
+		uint32_t						mJournalGeneration{ 1 };
+		uint64_t						mPauseJournalStart{ 0 };	// sequence number of the oldest entry
+		uint64_t						mPauseJournalEnd{ 0 };		// sequence number of the next entry
+		size_t							mPauseJournalLive{ 0 };		// entries not cancelled by coalescing
+		size_t							mPauseJournalLiveContinuous{ 0 };
+		size_t							mPauseJournalOverflows{ 0 };
+		int								mPauseCoalescing{ PauseCoalesceContinuous | PauseCoalesceButtonPairs };
+
+		static constexpr size_t DefaultPauseJournalCapacity = 1024;
+
+		ConcurrentInputEventQueue		mPostedEvents;
+
+		static constexpr size_t DefaultPostedEventCapacity = 4096;
+
+		struct RepeatBucket
+		{
+			BindingGroup<InputRepeater>	mRepeaters;
+			size_t						mActiveCount{ 0 };
+			KEngineCore::Timeout		mTimeout;
+		};
+
+		void StartRepeating(InputRepeater* repeater);
+		void StopRepeating(InputRepeater* repeater);
+		void StartFirstPeriod(InputRepeater* repeater);
+		void JoinRepeatBucket(InputRepeater* repeater);
+		void ParkRepeater(InputRepeater* repeater);
+		void UnparkRepeaters();
+
+		std::map<std::pair<KEngineCore::Timer*, float>, RepeatBucket>	mRepeatBuckets;
+		BindingGroup<InputRepeater>										mWaitingRepeaters;	// not in a bucket, by context
+
+		void RegisterAxis(KEngineCore::StringHash name, ControllerType controllerType, int id);
+		void RegisterButton(KEngineCore::StringHash name, ControllerType controllerType, int id);
+		void RegisterCursor(KEngineCore::StringHash name, ControllerType controllerType);
+		void ResizeStates();
+		void RefreshControlHandle(KEngineCore::StringHash name);
+
+		std::map<KEngineCore::StringHash, ControlIndex>	mButtonIndices;
+		std::map<KEngineCore::StringHash, ControlIndex>	mAxisIndices;
+		std::map<KEngineCore::StringHash, ControlIndex>	mCursorIndices;
+		std::map<KEngineCore::StringHash, InputControlHandle>	mControlHandles;	// map nodes never move, so handles stay valid
+		std::set<const void*>							mControlHandleAddresses;	// for checking handles that come back from Lua
+		int												mFrontState{ 0 };	// which of each player's mStates is published
+
+		// Events for the Lua frame handler (input.setFrameHandler), recorded where dispatch resolves them to
+		// controls and handed over in one call at the end of Flush.  Nothing is recorded without a handler, and a
+		// frame that swaps state buffers without flushing drops what it recorded instead of holding it forever.
+		struct FrameEvent
+		{
+			InputEventType		mType;
+			ControlIndex		mControl;
+			int					mPlayer;
+			float				mValue;		// axis position, 1 for button down, 0 for button up
+			KEngine2D::Point	mPosition;	// cursor position
+		};
+
+		inline void RecordFrameEvent(InputEventType type, ControlIndex control, const PlayerInput& player, float value, const KEngine2D::Point& position = { 0.0, 0.0 }) {
+			if (mFrameHandler != LUA_NOREF)
+			{
+				mFrameEvents.push_back({ type, control, (int)(&player - mPlayers), value, position });
+			}
+		}
+
+		void SetFrameHandler(lua_State* luaState, int index);
+		void ClearFrameHandler();
+		void RefreshFrameEventHandles();
+		void DeliverFrameEvents();
+
+		std::vector<FrameEvent>					mFrameEvents;
+		int										mFrameHandler{ LUA_NOREF };		// registry refs
+		int										mFrameEventTables{ LUA_NOREF };	// array of event tables, reused every frame
+		size_t									mFrameEventTableCount{ 0 };
+		bool									mFlushedSinceSwap{ false };
+		std::vector<const InputControlHandle*>	mButtonHandles;		// by ControlIndex, for naming frame events
+		std::vector<const InputControlHandle*>	mAxisHandles;
+		std::vector<const InputControlHandle*>	mCursorHandles;
 
 		friend class InputLibrary;
+		friend class InputRepeater;
 	};
 
 	class InputForwarder
@@ -437,7 +1264,7 @@ namespace KEngineBasics {
 	public:
 		InputForwarder();
 		~InputForwarder();
-		void Init(Input* input, std::function<void(ControllerType, int, int)> axisCallback, std::function<void(ControllerType, int)> buttonDownCallback, std::function<void(ControllerType, int)> buttonUpCallback, std::function<void(ControllerType, const KEngine2D::Point&)> cursorPostionCallback);
+		void Init(Input* input, InlineFunction<void(ControllerType, int, float)> axisCallback, InlineFunction<void(ControllerType, int)> buttonDownCallback, InlineFunction<void(ControllerType, int)> buttonUpCallback, InlineFunction<void(ControllerType, const KEngine2D::Point&)> cursorPostionCallback);
 		void Deinit(bool batched = false);
 
 		void HandleAxisChange(ControllerType type, int axisId, float axisPosition);
@@ -449,12 +1276,63 @@ namespace KEngineBasics {
 		std::list<InputForwarder*>::iterator	mPosition;
 		friend class Input;
 
-		std::function<void(ControllerType, int, int)>					mAxisCallback;
-		std::function<void(ControllerType, int)>						mButtonDownCallback;
-		std::function<void(ControllerType, int)>						mButtonUpCallback;
-		std::function<void(ControllerType, const KEngine2D::Point&)>	mCursorPositionCallback;
+		InlineFunction<void(ControllerType, int, float)>					mAxisCallback;
+		InlineFunction<void(ControllerType, int)>						mButtonDownCallback;
+		InlineFunction<void(ControllerType, int)>						mButtonUpCallback;
+		InlineFunction<void(ControllerType, const KEngine2D::Point&)>	mCursorPositionCallback;
+	};
+
+	// Free list of binding objects for InputLibrary, grown a block at a time and never shrunk.  Entries are
+	// constructed on Acquire and destroyed on Release, so a recycled binding holds no stale callbacks.
+	template<typename BindingType>
+	class InputBindingPool
+	{
+	public:
+		struct Entry
+		{
+			alignas(BindingType) unsigned char	mStorage[sizeof(BindingType)];
+			Entry*								mNext{ nullptr };	// next free entry, or next entry in its InputBindingSet
+
+			inline BindingType* Get() {
+				return std::launder(reinterpret_cast<BindingType*>(mStorage));
+			}
+		};
+
+		inline Entry* Acquire() {
+			if (mFree == nullptr)
+			{
+				Grow();
+			}
+			Entry* entry = mFree;
+			mFree = entry->mNext;
+			entry->mNext = nullptr;
+			new (entry->mStorage) BindingType;
+			return entry;
+		}
+
+		inline void Release(Entry* entry) {
+			entry->Get()->~BindingType();
+			entry->mNext = mFree;
+			mFree = entry;
+		}
+	private:
+		static constexpr size_t BlockSize = 32;
+
+		inline void Grow() {
+			mBlocks.push_back(std::make_unique<Entry[]>(BlockSize));
+			for (size_t i = 0; i < BlockSize; i++)
+			{
+				mBlocks.back()[i].mNext = mFree;
+				mFree = &mBlocks.back()[i];
+			}
+		}
+
+		std::vector<std::unique_ptr<Entry[]>>	mBlocks;
+		Entry*									mFree{ nullptr };
 	};
 
+	class InputBindingSet;
+
 	class InputLibrary : public KEngineCore::LuaLibraryTwo<Input>
 	{
 	public:
@@ -462,6 +1340,48 @@ namespace KEngineBasics {
 		~InputLibrary();
 		void Init(lua_State* luaState);
 		void Deinit();
+	private:
+		InputBindingPool<ButtonDownBinding>		mButtonDownPool;
+		InputBindingPool<ButtonUpBinding>		mButtonUpPool;
+		InputBindingPool<ButtonHoldBinding>		mButtonHoldPool;
+		InputBindingPool<CombinedAxisBinding>	mCombinedAxisPool;
+		InputBindingPool<ComboBinding>			mComboPool;
+		InputBindingSet*						mBindingSets{ nullptr };	// live sets, detached by Deinit before the pools go away
+		friend class InputBindingSet;
+	};
+
+	// The bindings made by one input.bind call, unbound together by input.unbind or when Lua collects the set.
+	// Each kind of binding is chained through its pool entries, so a set never allocates.  A set still alive
+	// when its InputLibrary deinits is detached then, and later does nothing.
+	class InputBindingSet
+	{
+	public:
+		InputBindingSet();
+		~InputBindingSet();
+		void Init(InputLibrary* library);
+		void Deinit();
+
+		ButtonDownBinding* AddButtonDownBinding();
+		ButtonUpBinding* AddButtonUpBinding();
+		ButtonHoldBinding* AddButtonHoldBinding();
+		CombinedAxisBinding* AddCombinedAxisBinding();
+		ComboBinding* AddComboBinding();
+
+		static const char MetaName[];
+	private:
+		template<typename BindingType>
+		BindingType* Add(InputBindingPool<BindingType>& pool, typename InputBindingPool<BindingType>::Entry*& list);
+		template<typename BindingType>
+		void ReleaseAll(InputBindingPool<BindingType>& pool, typename InputBindingPool<BindingType>::Entry*& list);
+
+		InputLibrary*									mLibrary{ nullptr };
+		InputBindingSet*								mPreviousSet{ nullptr };
+		InputBindingSet*								mNextSet{ nullptr };
+		InputBindingPool<ButtonDownBinding>::Entry*		mButtonDownBindings{ nullptr };
+		InputBindingPool<ButtonUpBinding>::Entry*		mButtonUpBindings{ nullptr };
+		InputBindingPool<ButtonHoldBinding>::Entry*		mButtonHoldBindings{ nullptr };
+		InputBindingPool<CombinedAxisBinding>::Entry*	mCombinedAxisBindings{ nullptr };
+		InputBindingPool<ComboBinding>::Entry*			mComboBindings{ nullptr };
 	};
 
 }
\ No newline at end of file
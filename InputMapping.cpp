@@ -0,0 +1,368 @@
+#include "InputMapping.h"
+#include <cstring>
+#include <cassert>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define KENGINE_INPUT_MAPPING_MMAP
+#endif
+
+using namespace KEngineBasics;
+using namespace KEngineBasics::InputMappingFormat;
+
+static constexpr size_t HeaderSize = sizeof(Magic) + sizeof(Version) + 2 * sizeof(uint32_t);
+
+template<typename T>
+static void Append(std::vector<uint8_t>& buffer, const T& value)
+{
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+	buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+template<typename T>
+static T Read(const uint8_t* data)
+{
+	T value;
+	memcpy(&value, data, sizeof(T));
+	return value;
+}
+
+static bool ParseControllerType(const std::string& word, uint8_t& controllerType)
+{
+	static const char* const names[] = { "keyboard", "gamepad", "joystick", "mouse", "virtual" };
+	for (uint8_t i = 0; i < std::size(names); i++)
+	{
+		if (word == names[i])
+		{
+			controllerType = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool ParseAxisType(const std::string& word, uint8_t& axisType)
+{
+	if (word == "horizontal" || word == "vertical")
+	{
+		axisType = word == "horizontal" ? Horizontal : Vertical;
+		return true;
+	}
+	return false;
+}
+
+KEngineBasics::InputMapping::InputMapping()
+{
+}
+
+KEngineBasics::InputMapping::~InputMapping()
+{
+	Deinit();
+}
+
+bool KEngineBasics::InputMapping::Compile(const std::string& text, std::string* error)
+{
+	Deinit();
+	std::vector<Record> records;
+	std::vector<uint8_t> strings;
+	std::map<std::string, uint32_t> stringOffsets;
+	auto intern = [&](const std::string& name) {
+		auto it = stringOffsets.find(name);
+		if (it == stringOffsets.end())
+		{
+			it = stringOffsets.emplace(name, (uint32_t)strings.size()).first;
+			strings.insert(strings.end(), name.begin(), name.end());
+			strings.push_back(0);
+		}
+		return it->second;
+	};
+
+	// Each kind of control has its own names; declaring one twice would silently rebind it.
+	std::set<std::string> buttons, axes, cursors, combinedAxes, virtualAxes;
+	std::istringstream lines(text);
+	std::string line;
+	for (int lineNumber = 1; std::getline(lines, line); lineNumber++)
+	{
+		line = line.substr(0, line.find('#'));
+		std::istringstream words(line);
+		std::string kind, name, parent, controller, axisType, button;
+		Record record{};
+		if (!(words >> kind))
+		{
+			continue;
+		}
+
+		bool valid = false;
+		bool declared = true;
+		const char* problem = "malformed line";
+		if (kind == "button" && (words >> name >> controller >> record.mId))
+		{
+			record.mKind = ButtonRecord;
+			valid = ParseControllerType(controller, record.mControllerType);
+			declared = buttons.insert(name).second;
+		}
+		else if (kind == "axis" && (words >> name >> controller >> record.mId))
+		{
+			record.mKind = AxisRecord;
+			valid = ParseControllerType(controller, record.mControllerType);
+			declared = axes.insert(name).second;
+		}
+		else if (kind == "cursor" && (words >> name >> controller))
+		{
+			record.mKind = CursorRecord;
+			valid = ParseControllerType(controller, record.mControllerType);
+			declared = cursors.insert(name).second;
+		}
+		else if (kind == "combined" && (words >> name))
+		{
+			record.mKind = CombinedAxisRecord;
+			valid = true;
+			declared = combinedAxes.insert(name).second;
+		}
+		else if (kind == "child" && (words >> parent >> name >> axisType >> controller >> record.mId))
+		{
+			record.mKind = ChildAxisRecord;
+			valid = ParseControllerType(controller, record.mControllerType) && ParseAxisType(axisType, record.mAxisType);
+			if (valid && !combinedAxes.contains(parent))
+			{
+				valid = false;
+				problem = "child of an undeclared combined axis";
+			}
+			declared = axes.insert(name).second;
+		}
+		else if (kind == "axisbutton")
+		{
+			int direction = 0;
+			record.mKind = AxisButtonRecord;
+			valid = (words >> parent >> name >> axisType >> direction >> controller >> record.mId) && (direction == -1 || direction == 1) &&
+				ParseAxisType(axisType, record.mAxisType) && ParseControllerType(controller, record.mControllerType);
+			record.mDirection = (int8_t)direction;
+			if (valid && !axes.contains(parent))
+			{
+				valid = false;
+				problem = "button for an undeclared axis";
+			}
+			declared = buttons.insert(name).second;
+		}
+		else if (kind == "virtual" && (words >> name >> parent >> axisType >> button >> record.mConversionRate))
+		{
+			record.mKind = VirtualAxisRecord;
+			valid = ParseAxisType(axisType, record.mAxisType);
+			if (valid && (!cursors.contains(parent) || !buttons.contains(button)))
+			{
+				valid = false;
+				problem = "virtual axis of an undeclared cursor or button";
+			}
+			declared = virtualAxes.insert(name).second;
+			record.mButton = intern(button);
+		}
+		std::string extra;
+		if (valid && (words >> extra))
+		{
+			valid = false;
+		}
+		if (valid && !declared)
+		{
+			valid = false;
+			problem = "duplicate control name";
+		}
+		if (!valid)
+		{
+			if (error != nullptr)
+			{
+				*error = "line " + std::to_string(lineNumber) + ": " + problem;
+			}
+			return false;
+		}
+		record.mName = intern(name);
+		record.mParent = parent.empty() ? 0 : intern(parent);
+		records.push_back(record);
+	}
+
+	mCompiled.clear();
+	mCompiled.insert(mCompiled.end(), std::begin(Magic), std::end(Magic));
+	Append(mCompiled, Version);
+	Append(mCompiled, (uint32_t)records.size());
+	Append(mCompiled, (uint32_t)strings.size());
+	for (const Record& record : records)
+	{
+		Append(mCompiled, record);
+	}
+	mCompiled.insert(mCompiled.end(), strings.begin(), strings.end());
+	mData = mCompiled.data();
+	mSize = mCompiled.size();
+	return Validate();
+}
+
+bool KEngineBasics::InputMapping::Load(const std::string& filename)
+{
+	Deinit();
+	if (!MapFile(filename))
+	{
+		return false;
+	}
+	if (!Validate())
+	{
+		Deinit();
+		return false;
+	}
+	return true;
+}
+
+bool KEngineBasics::InputMapping::Save(const std::string& filename) const
+{
+	if (mData == nullptr)
+	{
+		return false;
+	}
+	FILE* file = fopen(filename.c_str(), "wb");
+	if (file == nullptr)
+	{
+		return false;
+	}
+	bool written = fwrite(mData, 1, mSize, file) == mSize;
+	return fclose(file) == 0 && written;
+}
+
+bool KEngineBasics::InputMapping::LoadOrCompile(const std::string& textFilename, const std::string& cacheFilename, std::string* error)
+{
+	std::error_code textError, cacheError;
+	auto textTime = std::filesystem::last_write_time(textFilename, textError);
+	auto cacheTime = std::filesystem::last_write_time(cacheFilename, cacheError);
+	if (!cacheError && (textError || cacheTime >= textTime) && Load(cacheFilename))
+	{
+		return true;
+	}
+
+	std::ifstream file(textFilename);
+	if (!file)
+	{
+		if (error != nullptr)
+		{
+			*error = "can't read " + textFilename;
+		}
+		return false;
+	}
+	std::stringstream text;
+	text << file.rdbuf();
+	if (!Compile(text.str(), error))
+	{
+		return false;
+	}
+	Save(cacheFilename);
+	return true;
+}
+
+void KEngineBasics::InputMapping::Deinit()
+{
+	UnmapFile();
+	mRecords = nullptr;
+	mRecordCount = 0;
+	mStrings = nullptr;
+}
+
+std::span<const Record> KEngineBasics::InputMapping::GetRecords() const
+{
+	return { mRecords, mRecordCount };
+}
+
+const char* KEngineBasics::InputMapping::GetString(uint32_t offset) const
+{
+	return mStrings + offset;
+}
+
+// Checks the header and that every string reference lands inside a NUL-terminated string table, so a
+// truncated or corrupt cache is rejected rather than read out of bounds.
+bool KEngineBasics::InputMapping::Validate()
+{
+	if (mSize < HeaderSize || memcmp(mData, Magic, sizeof(Magic)) != 0 || Read<uint32_t>(mData + sizeof(Magic)) != Version)
+	{
+		return false;
+	}
+	uint32_t recordCount = Read<uint32_t>(mData + sizeof(Magic) + sizeof(Version));
+	uint32_t stringTableSize = Read<uint32_t>(mData + sizeof(Magic) + 2 * sizeof(uint32_t));
+	if (mSize != HeaderSize + (size_t)recordCount * sizeof(Record) + stringTableSize || (stringTableSize > 0 && mData[mSize - 1] != 0))
+	{
+		return false;
+	}
+	mRecords = reinterpret_cast<const Record*>(mData + HeaderSize);
+	mRecordCount = recordCount;
+	mStrings = reinterpret_cast<const char*>(mData + HeaderSize + recordCount * sizeof(Record));
+	for (const Record& record : GetRecords())
+	{
+		if (record.mKind > VirtualAxisRecord || record.mControllerType > Virtual || record.mAxisType > Vertical ||
+			record.mName >= stringTableSize || record.mParent >= std::max(stringTableSize, 1u) || record.mButton >= std::max(stringTableSize, 1u))
+		{
+			mRecords = nullptr;
+			mRecordCount = 0;
+			mStrings = nullptr;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool KEngineBasics::InputMapping::MapFile(const std::string& filename)
+{
+#ifdef KENGINE_INPUT_MAPPING_MMAP
+	int file = open(filename.c_str(), O_RDONLY);
+	if (file < 0)
+	{
+		return false;
+	}
+	struct stat fileStat;
+	if (fstat(file, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		close(file);
+		return false;
+	}
+	void* data = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (data == MAP_FAILED)
+	{
+		return false;
+	}
+	mData = static_cast<const uint8_t*>(data);
+	mSize = fileStat.st_size;
+	mMapped = true;
+	return true;
+#else
+	FILE* file = fopen(filename.c_str(), "rb");
+	if (file == nullptr)
+	{
+		return false;
+	}
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	mCompiled.resize(size > 0 ? size : 0);
+	size_t read = fread(mCompiled.data(), 1, mCompiled.size(), file);
+	fclose(file);
+	mData = mCompiled.data();
+	mSize = read;
+	return mSize > 0;
+#endif
+}
+
+void KEngineBasics::InputMapping::UnmapFile()
+{
+#ifdef KENGINE_INPUT_MAPPING_MMAP
+	if (mMapped)
+	{
+		munmap(const_cast<uint8_t*>(mData), mSize);
+	}
+#endif
+	mMapped = false;
+	mCompiled.clear();
+	mData = nullptr;
+	mSize = 0;
+}
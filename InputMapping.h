@@ -0,0 +1,85 @@
+#pragma once
+#include "Input.h"
+#include <string>
+#include <vector>
+#include <span>
+
+namespace KEngineBasics {
+
+	// Control mappings compiled from a text description into one flat blob: a header, a table of fixed-size
+	// records in declaration order, and a string table of the control names they refer to.  The blob is
+	// saved as a cache and memory-mapped on later loads, so startup reads it in place and hands the whole
+	// table to Input::AddMappings instead of parsing or making one call per control.
+	//
+	// The text format is one control per line, '#' starting a comment:
+	//   button <name> <controller> <id>
+	//   axis <name> <controller> <id>
+	//   cursor <name> <controller>
+	//   combined <name>
+	//   child <combined> <name> horizontal|vertical <controller> <id>
+	//   axisbutton <axis> <name> horizontal|vertical -1|1 <controller> <id>
+	//   virtual <name> <cursor> horizontal|vertical <button> <conversion rate>
+	// where <controller> is keyboard, gamepad, joystick, mouse or virtual.
+	namespace InputMappingFormat
+	{
+		static constexpr char		Magic[4] = { 'K', 'I', 'N', 'M' };
+		static constexpr uint32_t	Version = 1;
+
+		enum RecordKind : uint8_t {
+			ButtonRecord,
+			AxisRecord,
+			CursorRecord,
+			CombinedAxisRecord,
+			ChildAxisRecord,
+			AxisButtonRecord,
+			VirtualAxisRecord
+		};
+
+		struct Record
+		{
+			RecordKind	mKind;
+			uint8_t		mControllerType;
+			uint8_t		mAxisType;
+			int8_t		mDirection;
+			int32_t		mId;
+			uint32_t	mName;				// offsets into the string table
+			uint32_t	mParent;			// combined axis of a child, axis of an axis button, cursor of a virtual axis
+			uint32_t	mButton;			// converting button of a virtual axis
+			float		mConversionRate;
+		};
+
+		static_assert(sizeof(Record) == 24, "InputMapping records are stored as laid out here");
+	}
+
+	class InputMapping
+	{
+	public:
+		InputMapping();
+		~InputMapping();
+
+		// Parses a text description.  On failure the error names the offending line.
+		bool Compile(const std::string& text, std::string* error = nullptr);
+		// Maps a blob written by Save, checking its layout but not re-validating control references.
+		bool Load(const std::string& filename);
+		bool Save(const std::string& filename) const;
+		// Loads the cache if it is at least as new as the text file, and otherwise compiles the text and
+		// rewrites the cache (a cache that can't be written is not an error).
+		bool LoadOrCompile(const std::string& textFilename, const std::string& cacheFilename, std::string* error = nullptr);
+		void Deinit();
+
+		std::span<const InputMappingFormat::Record> GetRecords() const;
+		const char* GetString(uint32_t offset) const;
+	private:
+		bool MapFile(const std::string& filename);
+		void UnmapFile();
+		bool Validate();
+
+		const uint8_t*			mData{ nullptr };
+		size_t					mSize{ 0 };
+		std::vector<uint8_t>	mCompiled;		// blob built by Compile, or read where memory mapping isn't available
+		bool					mMapped{ false };
+		const InputMappingFormat::Record*	mRecords{ nullptr };
+		size_t					mRecordCount{ 0 };
+		const char*				mStrings{ nullptr };
+	};
+}
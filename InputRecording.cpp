@@ -0,0 +1,410 @@
+#include "InputRecording.h"
+#include <algorithm>
+#include <cstring>
+#include <cassert>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define KENGINE_INPUT_PLAYER_MMAP
+#endif
+
+using namespace KEngineBasics;
+using namespace KEngineBasics::InputRecordingFormat;
+
+static constexpr size_t HeaderSize = sizeof(Magic) + sizeof(Version);
+static constexpr size_t FrameRecordSize = 1 + sizeof(uint32_t) + sizeof(double);
+static constexpr size_t EventRecordSize = 1 + 1 + 1 + sizeof(int32_t) + sizeof(uint32_t);
+
+template<typename T>
+static void Append(std::vector<uint8_t>& buffer, const T& value)
+{
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+	buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+template<typename T>
+static T Read(const uint8_t* data)
+{
+	T value;
+	memcpy(&value, data, sizeof(T));
+	return value;
+}
+
+KEngineBasics::InputRecorder::InputRecorder()
+{
+}
+
+KEngineBasics::InputRecorder::~InputRecorder()
+{
+	Deinit();
+}
+
+bool KEngineBasics::InputRecorder::Init(Input* input, const std::string& filename)
+{
+	assert(mFile == nullptr);
+	mFile = fopen(filename.c_str(), "wb");
+	if (mFile == nullptr)
+	{
+		return false;
+	}
+
+	mBuffer.clear();
+	mBuffer.reserve(4096);
+	mBuffer.insert(mBuffer.end(), std::begin(Magic), std::end(Magic));
+	Append(mBuffer, Version);
+
+	mInput = input;
+	mStartTime = std::chrono::steady_clock::now();
+	mFrameCount = 0;
+	mFailed = false;
+	BeginFrame();
+
+	mForwarder.Init(input, [this](ControllerType type, int axisId, float axisPosition) {
+		WriteEvent(AxisChangeRecord, type, axisId, &axisPosition, sizeof(axisPosition));
+	}, [this](ControllerType type, int buttonId) {
+		WriteEvent(ButtonDownRecord, type, buttonId, nullptr, 0);
+	}, [this](ControllerType type, int buttonId) {
+		WriteEvent(ButtonUpRecord, type, buttonId, nullptr, 0);
+	}, [this](ControllerType type, const KEngine2D::Point& position) {
+		double coordinates[2] = { position.x, position.y };
+		WriteEvent(CursorPositionRecord, type, 0, coordinates, sizeof(coordinates));
+	});
+	return true;
+}
+
+void KEngineBasics::InputRecorder::Deinit()
+{
+	EndRecording();
+}
+
+bool KEngineBasics::InputRecorder::EndRecording()
+{
+	mForwarder.Deinit();
+	mInput = nullptr;
+	if (mFile != nullptr)
+	{
+		Flush();
+		if (fclose(mFile) != 0)
+		{
+			mFailed = true;
+		}
+		mFile = nullptr;
+	}
+	return !mFailed;
+}
+
+void KEngineBasics::InputRecorder::BeginFrame()
+{
+	assert(mFile != nullptr);
+	Flush();
+	mFrameStartTime = std::chrono::steady_clock::now();
+	double seconds = std::chrono::duration<double>(mFrameStartTime - mStartTime).count();
+	mBuffer.push_back(FrameRecord);
+	Append(mBuffer, mFrameCount++);
+	Append(mBuffer, seconds);
+}
+
+uint32_t KEngineBasics::InputRecorder::GetFrameCount() const
+{
+	return mFrameCount;
+}
+
+// Events are timed by when Input ingested them, not when they reach the forwarder, so batched, journaled and
+// posted events keep their place in the frame.  One ingested before the frame began is placed at its start.
+void KEngineBasics::InputRecorder::WriteEvent(RecordKind kind, ControllerType type, int id, const void* payload, size_t payloadSize)
+{
+	auto offset = std::chrono::duration_cast<std::chrono::microseconds>(std::max(mInput->GetEventTimestamp(), mFrameStartTime) - mFrameStartTime);
+	mBuffer.push_back(kind);
+	mBuffer.push_back((uint8_t)type);
+	mBuffer.push_back((uint8_t)mInput->GetEventDevice());
+	Append(mBuffer, (int32_t)id);
+	Append(mBuffer, (uint32_t)offset.count());
+	const uint8_t* bytes = static_cast<const uint8_t*>(payload);
+	mBuffer.insert(mBuffer.end(), bytes, bytes + payloadSize);
+}
+
+// After a failed write nothing more is written, so the log stays readable up to its last whole frame.
+void KEngineBasics::InputRecorder::Flush()
+{
+	if (!mBuffer.empty() && !mFailed)
+	{
+		if (fwrite(mBuffer.data(), 1, mBuffer.size(), mFile) != mBuffer.size() || fflush(mFile) != 0)
+		{
+			mFailed = true;
+		}
+	}
+	mBuffer.clear();
+}
+
+KEngineBasics::InputPlayer::InputPlayer()
+{
+}
+
+KEngineBasics::InputPlayer::~InputPlayer()
+{
+	Deinit();
+}
+
+bool KEngineBasics::InputPlayer::Init(Input* input, const std::string& filename)
+{
+	assert(mInput == nullptr);
+	if (!MapFile(filename))
+	{
+		return false;
+	}
+	if (mSize < HeaderSize || memcmp(mData, Magic, sizeof(Magic)) != 0)
+	{
+		UnmapFile();
+		return false;
+	}
+	if (Read<uint32_t>(mData + sizeof(Magic)) != Version)
+	{
+		UnmapFile();
+		return false;
+	}
+	mInput = input;
+	BuildFrameIndex();
+	mCursor = HeaderSize;
+	mFrameTime = 0.0;
+	mCurrentFrame = 0;
+	mPlayhead = 0.0;
+	mStartTime = std::chrono::steady_clock::now();
+	return true;
+}
+
+void KEngineBasics::InputPlayer::Deinit()
+{
+	UnmapFile();
+	mFrames.clear();
+	mInput = nullptr;
+}
+
+void KEngineBasics::InputPlayer::SetSpeed(double speed)
+{
+	mSpeed = speed;
+}
+
+void KEngineBasics::InputPlayer::Update(double deltaTime)
+{
+	assert(mInput != nullptr);
+	mPlayhead += deltaTime * mSpeed;
+	RecordKind kind;
+	double time;
+	InputEvent event;
+	while (size_t recordSize = ReadRecord(mCursor, kind, time, event))
+	{
+		if (kind == FrameRecord)
+		{
+			if (time > mPlayhead)
+			{
+				break;
+			}
+			mFrameTime = time;
+			mCurrentFrame = Read<uint32_t>(mData + mCursor + 1);
+		}
+		else
+		{
+			if (mFrameTime + time > mPlayhead)
+			{
+				break;
+			}
+			PlayEvent(time, event);
+		}
+		mCursor += recordSize;
+	}
+}
+
+bool KEngineBasics::InputPlayer::StepFrame()
+{
+	assert(mInput != nullptr);
+	RecordKind kind;
+	double time;
+	InputEvent event;
+	size_t recordSize = ReadRecord(mCursor, kind, time, event);
+	if (recordSize == 0 || kind != FrameRecord)
+	{
+		return false;
+	}
+	mFrameTime = mPlayhead = time;
+	mCurrentFrame = Read<uint32_t>(mData + mCursor + 1);
+	mCursor += recordSize;
+	while ((recordSize = ReadRecord(mCursor, kind, time, event)) != 0 && kind != FrameRecord)
+	{
+		PlayEvent(time, event);
+		mCursor += recordSize;
+	}
+	return true;
+}
+
+// Events are stamped with their recorded time, so that anything timed by it (combos, cursor samples) sees
+// the original spacing however fast the log is played or stepped.
+void KEngineBasics::InputPlayer::PlayEvent(double time, InputEvent& event)
+{
+	event.mTimestamp = mStartTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(mFrameTime + time));
+	mInput->HandleEvent(event);
+}
+
+bool KEngineBasics::InputPlayer::SeekToFrame(uint32_t frameIndex)
+{
+	if (frameIndex >= mFrames.size())
+	{
+		return false;
+	}
+	// Positions the playhead on the frame record without replaying anything before it.
+	mCursor = mFrames[frameIndex].mOffset;
+	mFrameTime = mPlayhead = mFrames[frameIndex].mTime;
+	mCurrentFrame = frameIndex;
+	return true;
+}
+
+uint32_t KEngineBasics::InputPlayer::GetFrameCount() const
+{
+	return (uint32_t)mFrames.size();
+}
+
+uint32_t KEngineBasics::InputPlayer::GetCurrentFrame() const
+{
+	return mCurrentFrame;
+}
+
+bool KEngineBasics::InputPlayer::IsFinished() const
+{
+	return mData == nullptr || mCursor >= mSize;
+}
+
+bool KEngineBasics::InputPlayer::MapFile(const std::string& filename)
+{
+#ifdef KENGINE_INPUT_PLAYER_MMAP
+	int file = open(filename.c_str(), O_RDONLY);
+	if (file < 0)
+	{
+		return false;
+	}
+	struct stat fileStat;
+	if (fstat(file, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		close(file);
+		return false;
+	}
+	void* data = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (data == MAP_FAILED)
+	{
+		return false;
+	}
+	mData = static_cast<const uint8_t*>(data);
+	mSize = fileStat.st_size;
+	mMapped = true;
+	return true;
+#else
+	FILE* file = fopen(filename.c_str(), "rb");
+	if (file == nullptr)
+	{
+		return false;
+	}
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	mFallbackData.resize(size > 0 ? size : 0);
+	size_t read = fread(mFallbackData.data(), 1, mFallbackData.size(), file);
+	fclose(file);
+	mData = mFallbackData.data();
+	mSize = read;
+	return mSize > 0;
+#endif
+}
+
+void KEngineBasics::InputPlayer::UnmapFile()
+{
+#ifdef KENGINE_INPUT_PLAYER_MMAP
+	if (mMapped)
+	{
+		munmap(const_cast<uint8_t*>(mData), mSize);
+	}
+#endif
+	mMapped = false;
+	mFallbackData.clear();
+	mData = nullptr;
+	mSize = 0;
+}
+
+void KEngineBasics::InputPlayer::BuildFrameIndex()
+{
+	mFrames.clear();
+	RecordKind kind;
+	double time;
+	InputEvent event;
+	size_t offset = HeaderSize;
+	while (size_t recordSize = ReadRecord(offset, kind, time, event))
+	{
+		if (kind == FrameRecord)
+		{
+			mFrames.push_back({ offset, time });
+		}
+		offset += recordSize;
+	}
+}
+
+// Decodes the record at offset, returning its size, or 0 at the end of the data or a truncated record.
+// Frame records report their absolute time; event records report their offset into the frame.
+size_t KEngineBasics::InputPlayer::ReadRecord(size_t offset, RecordKind& kind, double& time, InputEvent& event) const
+{
+	if (offset >= mSize)
+	{
+		return 0;
+	}
+	const uint8_t* record = mData + offset;
+	size_t available = mSize - offset;
+	kind = (RecordKind)record[0];
+	if (kind == FrameRecord)
+	{
+		if (available < FrameRecordSize)
+		{
+			return 0;
+		}
+		time = Read<double>(record + 1 + sizeof(uint32_t));
+		return FrameRecordSize;
+	}
+
+	size_t payloadSize = 0;
+	switch (kind)
+	{
+	case AxisChangeRecord:
+		event.mType = AxisChangeEvent;
+		payloadSize = sizeof(float);
+		break;
+	case ButtonDownRecord:
+		event.mType = ButtonDownEvent;
+		break;
+	case ButtonUpRecord:
+		event.mType = ButtonUpEvent;
+		break;
+	case CursorPositionRecord:
+		event.mType = CursorPositionEvent;
+		payloadSize = 2 * sizeof(double);
+		break;
+	default:
+		return 0;
+	}
+	if (available < EventRecordSize + payloadSize)
+	{
+		return 0;
+	}
+	event.mControllerType = (ControllerType)record[1];
+	event.mDevice = record[2];
+	event.mId = Read<int32_t>(record + 3);
+	time = Read<uint32_t>(record + 3 + sizeof(int32_t)) * 1e-6;
+	const uint8_t* payload = record + EventRecordSize;
+	if (kind == AxisChangeRecord)
+	{
+		event.mValue = Read<float>(payload);
+	}
+	else if (kind == CursorPositionRecord)
+	{
+		event.mPosition = { Read<double>(payload), Read<double>(payload + sizeof(double)) };
+	}
+	return EventRecordSize + payloadSize;
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include "Input.h"
+#include <string>
+#include <vector>
+#include <cstdio>
+
+namespace KEngineBasics {
+
+	// Binary input log.  The file is a small header followed by an append-only stream of records: a frame
+	// record (frame index and seconds since recording began) written by BeginFrame, then one record per
+	// axis, button or cursor event, timestamped in microseconds from the start of its frame.  Nothing is
+	// written after the fact, so a log cut short by a crash is still readable up to its last whole record.
+	// Values are stored in native byte order (little-endian on every platform we ship).
+	namespace InputRecordingFormat
+	{
+		static constexpr char		Magic[4] = { 'K', 'I', 'N', 'R' };
+		static constexpr uint32_t	Version = 2;
+
+		enum RecordKind : uint8_t {
+			FrameRecord,
+			AxisChangeRecord,
+			ButtonDownRecord,
+			ButtonUpRecord,
+			CursorPositionRecord
+		};
+	}
+
+	class InputRecorder
+	{
+	public:
+		InputRecorder();
+		~InputRecorder();
+		bool Init(Input* input, const std::string& filename);
+		void Deinit();
+
+		// Writes out what is buffered and closes the file.  Returns false if any write failed (a full disk,
+		// say), in which case the log ends at the last frame written before the failure.
+		bool EndRecording();
+
+		// Call once per frame, before that frame's input is handled.
+		void BeginFrame();
+
+		uint32_t GetFrameCount() const;
+	private:
+		void WriteEvent(InputRecordingFormat::RecordKind kind, ControllerType type, int id, const void* payload, size_t payloadSize);
+		void Flush();
+
+		Input*									mInput{ nullptr };
+		InputForwarder							mForwarder;
+		FILE*									mFile{ nullptr };
+		std::vector<uint8_t>					mBuffer;
+		std::chrono::steady_clock::time_point	mStartTime;
+		std::chrono::steady_clock::time_point	mFrameStartTime;
+		uint32_t								mFrameCount{ 0 };
+		bool									mFailed{ false };
+	};
+
+	class InputPlayer
+	{
+	public:
+		InputPlayer();
+		~InputPlayer();
+		bool Init(Input* input, const std::string& filename);
+		void Deinit();
+
+		// Time-based playback: advances the playhead by deltaTime * speed and feeds every event up to it.
+		void SetSpeed(double speed);
+		void Update(double deltaTime);
+
+		// Frame-locked playback: feeds exactly the events recorded in the next frame, independent of time.
+		bool StepFrame();
+
+		bool SeekToFrame(uint32_t frameIndex);
+		uint32_t GetFrameCount() const;
+		uint32_t GetCurrentFrame() const;
+		bool IsFinished() const;
+	private:
+		bool MapFile(const std::string& filename);
+		void UnmapFile();
+		void BuildFrameIndex();
+		size_t ReadRecord(size_t offset, InputRecordingFormat::RecordKind& kind, double& time, InputEvent& event) const;
+		void PlayEvent(double time, InputEvent& event);
+
+		Input*					mInput{ nullptr };
+		const uint8_t*			mData{ nullptr };
+		size_t					mSize{ 0 };
+		std::vector<uint8_t>	mFallbackData;	// used where memory mapping isn't available
+		bool					mMapped{ false };
+
+		struct FrameEntry
+		{
+			size_t	mOffset;
+			double	mTime;
+		};
+		std::vector<FrameEntry>	mFrames;
+
+		size_t					mCursor{ 0 };			// offset of the next unread record
+		double					mFrameTime{ 0.0 };		// start time of the frame mCursor is in
+		uint32_t				mCurrentFrame{ 0 };
+		double					mPlayhead{ 0.0 };
+		double					mSpeed{ 1.0 };
+		std::chrono::steady_clock::time_point	mStartTime;	// stands in for the recording's start, for event timestamps
+	};
+}
@@ -0,0 +1,656 @@
+#include "InputStream.h"
+#include <cstring>
+#include <cassert>
+#include <cmath>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <csignal>
+#include <cerrno>
+#define KENGINE_INPUT_STREAM_POSIX
+#endif
+
+using namespace KEngineBasics;
+using namespace KEngineBasics::InputStreamFormat;
+
+static constexpr size_t HeaderSize = sizeof(Magic) + sizeof(Version);
+
+// Event tag byte: event type in bits 0-1, controller type in bits 2-4, then flags.
+static constexpr uint8_t EventTypeMask = 0x03;
+static constexpr int ControllerTypeShift = 2;
+static constexpr uint8_t ControllerTypeMask = 0x07;
+static constexpr uint8_t DeviceChangedFlag = 0x20;
+static constexpr uint8_t RawCursorFlag = 0x40;	// cursor position isn't whole pixels, so two doubles follow
+
+static void AppendVarint(std::vector<uint8_t>& buffer, uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		buffer.push_back((uint8_t)(value | 0x80));
+		value >>= 7;
+	}
+	buffer.push_back((uint8_t)value);
+}
+
+static void AppendSignedVarint(std::vector<uint8_t>& buffer, int64_t value)
+{
+	AppendVarint(buffer, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+static bool ReadVarint(const uint8_t*& data, const uint8_t* end, uint64_t& value)
+{
+	value = 0;
+	for (int shift = 0; shift < 64 && data < end; shift += 7)
+	{
+		uint8_t byte = *data++;
+		value |= (uint64_t)(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool ReadSignedVarint(const uint8_t*& data, const uint8_t* end, int64_t& value)
+{
+	uint64_t encoded;
+	if (!ReadVarint(data, end, encoded))
+	{
+		return false;
+	}
+	value = (int64_t)(encoded >> 1) ^ -(int64_t)(encoded & 1);
+	return true;
+}
+
+static bool IsWholePixel(double coordinate)
+{
+	return std::floor(coordinate) == coordinate && std::fabs(coordinate) < 9.0e15;
+}
+
+#ifdef KENGINE_INPUT_STREAM_POSIX
+static bool SetNonBlocking(int fileDescriptor)
+{
+	int flags = fcntl(fileDescriptor, F_GETFL, 0);
+	return flags >= 0 && fcntl(fileDescriptor, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+static bool MakeSocketAddress(const std::string& socketPath, sockaddr_un& address)
+{
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (socketPath.size() >= sizeof(address.sun_path))
+	{
+		return false;
+	}
+	memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+	return true;
+}
+
+// Holds SIGPIPE blocked on this thread while it lives, so that writing to a pipe whose reader has gone fails
+// with EPIPE instead of killing the process.  A SIGPIPE raised meanwhile is taken off the pending set before
+// the mask is restored, unless one was pending already.
+class PipeSignalBlock
+{
+public:
+	PipeSignalBlock(bool enabled)
+		: mEnabled(enabled)
+	{
+		if (mEnabled)
+		{
+			sigemptyset(&mPipeSignal);
+			sigaddset(&mPipeSignal, SIGPIPE);
+			mWasPending = IsPending();
+			pthread_sigmask(SIG_BLOCK, &mPipeSignal, &mPreviousMask);
+		}
+	}
+
+	~PipeSignalBlock()
+	{
+		if (mEnabled)
+		{
+			int signal;
+			if (!mWasPending && IsPending())
+			{
+				sigwait(&mPipeSignal, &signal);
+			}
+			pthread_sigmask(SIG_SETMASK, &mPreviousMask, nullptr);
+		}
+	}
+private:
+	static bool IsPending()
+	{
+		sigset_t pending;
+		sigemptyset(&pending);
+		sigpending(&pending);
+		return sigismember(&pending, SIGPIPE) == 1;
+	}
+
+	bool		mEnabled;
+	bool		mWasPending{ false };
+	sigset_t	mPipeSignal;
+	sigset_t	mPreviousMask;
+};
+#endif
+
+KEngineBasics::InputStreamWriter::InputStreamWriter()
+{
+}
+
+KEngineBasics::InputStreamWriter::~InputStreamWriter()
+{
+	Deinit();
+}
+
+bool KEngineBasics::InputStreamWriter::Init(Input* input, int fileDescriptor)
+{
+	assert(mFileDescriptor < 0);
+#ifdef KENGINE_INPUT_STREAM_POSIX
+	if (!SetNonBlocking(fileDescriptor))
+	{
+		close(fileDescriptor);
+		return false;
+	}
+	struct stat status;
+	mSocket = fstat(fileDescriptor, &status) == 0 && S_ISSOCK(status.st_mode);
+#ifdef SO_NOSIGPIPE
+	if (mSocket)
+	{
+		int noSignal = 1;
+		setsockopt(fileDescriptor, SOL_SOCKET, SO_NOSIGPIPE, &noSignal, sizeof(noSignal));
+	}
+#endif
+	mInput = input;
+	mFileDescriptor = fileDescriptor;
+	mFrame.clear();
+	mPending.clear();
+	mPending.insert(mPending.end(), std::begin(Magic), std::end(Magic));
+	const uint8_t* version = reinterpret_cast<const uint8_t*>(&Version);
+	mPending.insert(mPending.end(), version, version + sizeof(Version));
+	mEncoder = {};
+	mDroppedFrames = 0;
+
+	mForwarder.Init(input, [this](ControllerType type, int axisId, float axisPosition) {
+		WriteEvent(AxisChangeEvent, type, axisId, axisPosition, { 0.0, 0.0 });
+	}, [this](ControllerType type, int buttonId) {
+		WriteEvent(ButtonDownEvent, type, buttonId, 0.0f, { 0.0, 0.0 });
+	}, [this](ControllerType type, int buttonId) {
+		WriteEvent(ButtonUpEvent, type, buttonId, 0.0f, { 0.0, 0.0 });
+	}, [this](ControllerType type, const KEngine2D::Point& position) {
+		WriteEvent(CursorPositionEvent, type, 0, 0.0f, position);
+	});
+	return true;
+#else
+	(void)input;
+	(void)fileDescriptor;
+	return false;
+#endif
+}
+
+bool KEngineBasics::InputStreamWriter::Connect(Input* input, const std::string& socketPath)
+{
+#ifdef KENGINE_INPUT_STREAM_POSIX
+	sockaddr_un address;
+	if (!MakeSocketAddress(socketPath, address))
+	{
+		return false;
+	}
+	int fileDescriptor = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fileDescriptor < 0)
+	{
+		return false;
+	}
+	if (connect(fileDescriptor, (const sockaddr*)&address, sizeof(address)) != 0)
+	{
+		close(fileDescriptor);
+		return false;
+	}
+	return Init(input, fileDescriptor);
+#else
+	(void)input;
+	(void)socketPath;
+	return false;
+#endif
+}
+
+void KEngineBasics::InputStreamWriter::Deinit()
+{
+	mForwarder.Deinit();
+#ifdef KENGINE_INPUT_STREAM_POSIX
+	if (mFileDescriptor >= 0)
+	{
+		close(mFileDescriptor);
+	}
+#endif
+	mFileDescriptor = -1;
+	mFrame.clear();
+	mPending.clear();
+	mInput = nullptr;
+}
+
+void KEngineBasics::InputStreamWriter::SendFrame()
+{
+	if (mFileDescriptor < 0)
+	{
+		mFrame.clear();
+		return;
+	}
+	if (!mFrame.empty())
+	{
+		if (!WritePendingBytes())
+		{
+			return;
+		}
+		if (mPending.size() > MaxPendingBytes)
+		{
+			mDroppedFrames++;
+		}
+		else
+		{
+			AppendVarint(mPending, mFrame.size());
+			mPending.insert(mPending.end(), mFrame.begin(), mFrame.end());
+		}
+		mFrame.clear();
+		mEncoder = {};
+	}
+	WritePendingBytes();
+}
+
+size_t KEngineBasics::InputStreamWriter::GetDroppedFrameCount() const
+{
+	return mDroppedFrames;
+}
+
+void KEngineBasics::InputStreamWriter::WriteEvent(InputEventType type, ControllerType controllerType, int id, float value, const KEngine2D::Point& position)
+{
+	int device = mInput->GetEventDevice();
+	bool rawCursor = type == CursorPositionEvent && !(IsWholePixel(position.x) && IsWholePixel(position.y));
+	uint8_t tag = (uint8_t)type | (uint8_t)(controllerType << ControllerTypeShift);
+	if (device != mEncoder.mDevice)
+	{
+		tag |= DeviceChangedFlag;
+	}
+	if (rawCursor)
+	{
+		tag |= RawCursorFlag;
+	}
+	mFrame.push_back(tag);
+	if (device != mEncoder.mDevice)
+	{
+		AppendSignedVarint(mFrame, (int64_t)device - mEncoder.mDevice);
+		mEncoder.mDevice = device;
+	}
+
+	switch (type)
+	{
+	case AxisChangeEvent:
+	{
+		AppendSignedVarint(mFrame, (int64_t)id - mEncoder.mId);
+		mEncoder.mId = id;
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		AppendSignedVarint(mFrame, (int32_t)(bits - mEncoder.mAxisBits));
+		mEncoder.mAxisBits = bits;
+		break;
+	}
+	case ButtonDownEvent:
+	case ButtonUpEvent:
+		AppendSignedVarint(mFrame, (int64_t)id - mEncoder.mId);
+		mEncoder.mId = id;
+		break;
+	case CursorPositionEvent:
+		if (rawCursor)
+		{
+			const uint8_t* coordinates[2] = { reinterpret_cast<const uint8_t*>(&position.x), reinterpret_cast<const uint8_t*>(&position.y) };
+			for (const uint8_t* coordinate : coordinates)
+			{
+				mFrame.insert(mFrame.end(), coordinate, coordinate + sizeof(double));
+			}
+		}
+		else
+		{
+			int64_t x = (int64_t)position.x;
+			int64_t y = (int64_t)position.y;
+			AppendSignedVarint(mFrame, x - mEncoder.mCursorX);
+			AppendSignedVarint(mFrame, y - mEncoder.mCursorY);
+			mEncoder.mCursorX = x;
+			mEncoder.mCursorY = y;
+		}
+		break;
+	}
+}
+
+// Writes as much of mPending as the descriptor takes without blocking.  Returns false, and closes the
+// stream, if the reader has gone.  Sockets are written so they can't raise SIGPIPE; pipes have it blocked.
+bool KEngineBasics::InputStreamWriter::WritePendingBytes()
+{
+#ifdef KENGINE_INPUT_STREAM_POSIX
+	if (mPending.empty())
+	{
+		return true;
+	}
+#if defined(MSG_NOSIGNAL) || defined(SO_NOSIGPIPE)
+	PipeSignalBlock pipeSignalBlock(!mSocket);
+#else
+	PipeSignalBlock pipeSignalBlock(true);
+#endif
+	size_t written = 0;
+	while (written < mPending.size())
+	{
+#ifdef MSG_NOSIGNAL
+		ssize_t result = mSocket ? send(mFileDescriptor, mPending.data() + written, mPending.size() - written, MSG_NOSIGNAL) :
+			write(mFileDescriptor, mPending.data() + written, mPending.size() - written);
+#else
+		ssize_t result = write(mFileDescriptor, mPending.data() + written, mPending.size() - written);
+#endif
+		if (result < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+			{
+				break;
+			}
+			close(mFileDescriptor);
+			mFileDescriptor = -1;
+			mPending.clear();
+			return false;
+		}
+		written += result;
+	}
+	mPending.erase(mPending.begin(), mPending.begin() + written);
+	return true;
+#else
+	return false;
+#endif
+}
+
+KEngineBasics::InputStreamReader::InputStreamReader()
+{
+}
+
+KEngineBasics::InputStreamReader::~InputStreamReader()
+{
+	Deinit();
+}
+
+bool KEngineBasics::InputStreamReader::Init(Input* input, int fileDescriptor)
+{
+	assert(mFileDescriptor < 0);
+#ifdef KENGINE_INPUT_STREAM_POSIX
+	if (!SetNonBlocking(fileDescriptor))
+	{
+		close(fileDescriptor);
+		return false;
+	}
+	mInput = input;
+	mFileDescriptor = fileDescriptor;
+	mBuffer.clear();
+	mHeaderRead = false;
+	mFailed = false;
+	return true;
+#else
+	(void)input;
+	(void)fileDescriptor;
+	return false;
+#endif
+}
+
+bool KEngineBasics::InputStreamReader::Listen(Input* input, const std::string& socketPath)
+{
+	assert(mListenDescriptor < 0 && mFileDescriptor < 0);
+#ifdef KENGINE_INPUT_STREAM_POSIX
+	sockaddr_un address;
+	if (!MakeSocketAddress(socketPath, address))
+	{
+		return false;
+	}
+	int listenDescriptor = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listenDescriptor < 0)
+	{
+		return false;
+	}
+	unlink(socketPath.c_str());
+	if (bind(listenDescriptor, (const sockaddr*)&address, sizeof(address)) != 0 || listen(listenDescriptor, 1) != 0 || !SetNonBlocking(listenDescriptor))
+	{
+		close(listenDescriptor);
+		return false;
+	}
+	mInput = input;
+	mListenDescriptor = listenDescriptor;
+	mSocketPath = socketPath;
+	mBuffer.clear();
+	mHeaderRead = false;
+	mFailed = false;
+	return true;
+#else
+	(void)input;
+	(void)socketPath;
+	return false;
+#endif
+}
+
+void KEngineBasics::InputStreamReader::Deinit()
+{
+#ifdef KENGINE_INPUT_STREAM_POSIX
+	if (mFileDescriptor >= 0)
+	{
+		close(mFileDescriptor);
+	}
+	if (mListenDescriptor >= 0)
+	{
+		close(mListenDescriptor);
+		unlink(mSocketPath.c_str());
+	}
+#endif
+	mFileDescriptor = -1;
+	mListenDescriptor = -1;
+	mSocketPath.clear();
+	mBuffer.clear();
+	mInput = nullptr;
+}
+
+size_t KEngineBasics::InputStreamReader::Update(bool batched)
+{
+#ifdef KENGINE_INPUT_STREAM_POSIX
+	if (mFileDescriptor < 0 && !Accept())
+	{
+		return 0;
+	}
+	uint8_t chunk[4096];
+	while (mFileDescriptor >= 0 && !mFailed)
+	{
+		ssize_t result = read(mFileDescriptor, chunk, sizeof(chunk));
+		if (result > 0)
+		{
+			mBuffer.insert(mBuffer.end(), chunk, chunk + result);
+			continue;
+		}
+		if (result < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (result == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+		{
+			// The writer has gone; whatever whole frames arrived are still fed below.
+			close(mFileDescriptor);
+			mFileDescriptor = -1;
+		}
+		break;
+	}
+	return DecodeFrames(batched);
+#else
+	(void)batched;
+	return 0;
+#endif
+}
+
+bool KEngineBasics::InputStreamReader::IsConnected() const
+{
+	return mFileDescriptor >= 0;
+}
+
+bool KEngineBasics::InputStreamReader::HasFailed() const
+{
+	return mFailed;
+}
+
+bool KEngineBasics::InputStreamReader::Accept()
+{
+#ifdef KENGINE_INPUT_STREAM_POSIX
+	if (mListenDescriptor < 0)
+	{
+		return false;
+	}
+	int fileDescriptor = accept(mListenDescriptor, nullptr, nullptr);
+	if (fileDescriptor < 0 || !SetNonBlocking(fileDescriptor))
+	{
+		if (fileDescriptor >= 0)
+		{
+			close(fileDescriptor);
+		}
+		return false;
+	}
+	mFileDescriptor = fileDescriptor;
+	mBuffer.clear();
+	mHeaderRead = false;
+	mFailed = false;
+	return true;
+#else
+	return false;
+#endif
+}
+
+size_t KEngineBasics::InputStreamReader::DecodeFrames(bool batched)
+{
+	size_t offset = 0;
+	size_t eventCount = 0;
+	if (!mHeaderRead && !mFailed && mBuffer.size() >= HeaderSize)
+	{
+		uint32_t version;
+		memcpy(&version, mBuffer.data() + sizeof(Magic), sizeof(version));
+		mFailed = memcmp(mBuffer.data(), Magic, sizeof(Magic)) != 0 || version != Version;
+		mHeaderRead = true;
+		offset = HeaderSize;
+	}
+	while (mHeaderRead && !mFailed)
+	{
+		const uint8_t* data = mBuffer.data() + offset;
+		const uint8_t* end = mBuffer.data() + mBuffer.size();
+		uint64_t frameSize;
+		if (!ReadVarint(data, end, frameSize))
+		{
+			mFailed = end - data >= 10;	// a varint is never longer than 10 bytes
+			break;
+		}
+		if (frameSize > (uint64_t)(end - data))
+		{
+			break;
+		}
+		if (!DecodeFrame(data, (size_t)frameSize, batched, eventCount))
+		{
+			mFailed = true;
+			break;
+		}
+		offset = (data - mBuffer.data()) + (size_t)frameSize;
+	}
+	mBuffer.erase(mBuffer.begin(), mBuffer.begin() + offset);
+	return eventCount;
+}
+
+bool KEngineBasics::InputStreamReader::DecodeFrame(const uint8_t* data, size_t size, bool batched, size_t& eventCount)
+{
+	const uint8_t* end = data + size;
+	int id = 0;
+	int device = 0;
+	uint32_t axisBits = 0;
+	int64_t cursorX = 0;
+	int64_t cursorY = 0;
+	while (data < end)
+	{
+		uint8_t tag = *data++;
+		InputEvent event{ (InputEventType)(tag & EventTypeMask), (ControllerType)((tag >> ControllerTypeShift) & ControllerTypeMask) };
+		if (event.mControllerType > Virtual)
+		{
+			return false;
+		}
+		int64_t delta;
+		if (tag & DeviceChangedFlag)
+		{
+			if (!ReadSignedVarint(data, end, delta))
+			{
+				return false;
+			}
+			device += (int)delta;
+		}
+		event.mDevice = device;
+
+		switch (event.mType)
+		{
+		case AxisChangeEvent:
+			if (!ReadSignedVarint(data, end, delta))
+			{
+				return false;
+			}
+			id += (int)delta;
+			if (!ReadSignedVarint(data, end, delta))
+			{
+				return false;
+			}
+			axisBits += (uint32_t)(int32_t)delta;
+			memcpy(&event.mValue, &axisBits, sizeof(axisBits));
+			event.mId = id;
+			break;
+		case ButtonDownEvent:
+		case ButtonUpEvent:
+			if (!ReadSignedVarint(data, end, delta))
+			{
+				return false;
+			}
+			id += (int)delta;
+			event.mId = id;
+			break;
+		case CursorPositionEvent:
+			if (tag & RawCursorFlag)
+			{
+				if (end - data < (ptrdiff_t)(2 * sizeof(double)))
+				{
+					return false;
+				}
+				memcpy(&event.mPosition.x, data, sizeof(double));
+				memcpy(&event.mPosition.y, data + sizeof(double), sizeof(double));
+				data += 2 * sizeof(double);
+			}
+			else
+			{
+				int64_t deltaY;
+				if (!ReadSignedVarint(data, end, delta) || !ReadSignedVarint(data, end, deltaY))
+				{
+					return false;
+				}
+				cursorX += delta;
+				cursorY += deltaY;
+				event.mPosition = { (double)cursorX, (double)cursorY };
+			}
+			break;
+		}
+
+		if (batched)
+		{
+			mInput->SubmitEvent(event);
+		}
+		else
+		{
+			mInput->HandleEvent(event);
+		}
+		eventCount++;
+	}
+	return true;
+}
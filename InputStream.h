@@ -0,0 +1,87 @@
+#pragma once
+#include "Input.h"
+#include <string>
+#include <vector>
+
+namespace KEngineBasics {
+
+	// Live input stream for another process (spectator views, overlays, tools).  After a small header the
+	// stream is a sequence of frames, each a varint byte count followed by that frame's events.  Events are
+	// delta-encoded against the previous event of the same frame: ids and devices as zigzag varints, axis
+	// values as the difference of their float bit patterns, and cursor positions as integer deltas when they
+	// are whole pixels.  Every frame starts from zero, so frames decode on their own.
+	namespace InputStreamFormat
+	{
+		static constexpr char		Magic[4] = { 'K', 'I', 'N', 'S' };
+		static constexpr uint32_t	Version = 1;
+	}
+
+	// Sends the events Input dispatches, batched per frame, to a pipe or Unix domain socket.  Writes never
+	// block: bytes the reader hasn't taken yet are kept, and once more than MaxPendingBytes are waiting, whole
+	// frames are dropped (and counted) until it catches up.
+	class InputStreamWriter
+	{
+	public:
+		static constexpr size_t MaxPendingBytes = 1 << 20;
+
+		InputStreamWriter();
+		~InputStreamWriter();
+		bool Init(Input* input, int fileDescriptor);	// takes ownership of the descriptor
+		bool Connect(Input* input, const std::string& socketPath);
+		void Deinit();
+
+		// Call once per frame to send the events gathered since the last call.
+		void SendFrame();
+
+		size_t GetDroppedFrameCount() const;
+	private:
+		struct EncoderState
+		{
+			int			mId{ 0 };
+			int			mDevice{ 0 };
+			uint32_t	mAxisBits{ 0 };
+			int64_t		mCursorX{ 0 };
+			int64_t		mCursorY{ 0 };
+		};
+
+		void WriteEvent(InputEventType type, ControllerType controllerType, int id, float value, const KEngine2D::Point& position);
+		bool WritePendingBytes();
+
+		Input*									mInput{ nullptr };
+		InputForwarder							mForwarder;
+		int										mFileDescriptor{ -1 };
+		bool									mSocket{ false };	// otherwise a pipe, whose writes can raise SIGPIPE
+		std::vector<uint8_t>					mFrame;		// events of the frame being gathered
+		std::vector<uint8_t>					mPending;	// encoded frames not yet written
+		EncoderState							mEncoder;
+		size_t									mDroppedFrames{ 0 };
+	};
+
+	// Receiving end of an InputStreamWriter.  Update reads whatever has arrived without blocking and feeds
+	// every whole frame to the Input it was given, directly or into its SubmitEvent batch.
+	class InputStreamReader
+	{
+	public:
+		InputStreamReader();
+		~InputStreamReader();
+		bool Init(Input* input, int fileDescriptor);	// takes ownership of the descriptor
+		bool Listen(Input* input, const std::string& socketPath);	// accepts one writer, during Update
+		void Deinit();
+
+		size_t Update(bool batched = false);	// returns the number of events fed
+		bool IsConnected() const;
+		bool HasFailed() const;	// bad header or malformed frame; the stream is abandoned
+	private:
+		bool Accept();
+		size_t DecodeFrames(bool batched);
+		bool DecodeFrame(const uint8_t* data, size_t size, bool batched, size_t& eventCount);
+
+		Input*					mInput{ nullptr };
+		int						mListenDescriptor{ -1 };
+		int						mFileDescriptor{ -1 };
+		std::string				mSocketPath;
+		std::vector<uint8_t>	mBuffer;
+		bool					mHeaderRead{ false };
+		bool					mFailed{ false };
+	};
+}
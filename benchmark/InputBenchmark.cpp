@@ -0,0 +1,359 @@
+// Headless micro-benchmarks for Input dispatch.  Builds synthetic control/binding configurations and reports
+// time per event, heap allocations per event and throughput for each scenario.  No device, window or Lua
+// state is needed.
+//
+// Usage: KEngineBasicsInputBenchmark [--controls N] [--bindings M] [--forwarders F] [--events E]
+
+#include "Input.h"
+#include "Timer.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace KEngineBasics;
+
+static std::atomic<size_t> sAllocationCount{ 0 };
+
+void* operator new(size_t size)
+{
+	sAllocationCount.fetch_add(1, std::memory_order_relaxed);
+	if (void* memory = malloc(size ? size : 1))
+	{
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	free(memory);
+}
+
+struct BenchmarkConfig
+{
+	int		mControls{ 64 };
+	int		mBindingsPerControl{ 4 };
+	int		mForwarders{ 1 };
+	int		mEvents{ 200000 };
+};
+
+struct BenchmarkResult
+{
+	const char*	mName;
+	double		mNanosecondsPerEvent;
+	double		mAllocationsPerEvent;
+	double		mEventsPerSecond;
+};
+
+static std::vector<BenchmarkResult> sResults;
+static int sSink = 0;	// written by every callback and printed at the end, so no work can be optimized away
+
+template<typename Function>
+static void Measure(const char* name, int events, Function&& function)
+{
+	size_t allocationsBefore = sAllocationCount.load(std::memory_order_relaxed);
+	auto start = std::chrono::steady_clock::now();
+	function();
+	auto end = std::chrono::steady_clock::now();
+	size_t allocations = sAllocationCount.load(std::memory_order_relaxed) - allocationsBefore;
+
+	double nanoseconds = std::chrono::duration<double, std::nano>(end - start).count();
+	sResults.push_back({ name, nanoseconds / events, (double)allocations / events, events / (nanoseconds * 1e-9) });
+}
+
+static std::string ControlName(const char* prefix, int index)
+{
+	return std::string(prefix) + std::to_string(index);
+}
+
+// Owns an Input configured with the requested number of controls, bindings and forwarders.
+class BenchmarkFixture
+{
+public:
+	BenchmarkFixture(const BenchmarkConfig& config)
+		: mConfig(config)
+	{
+		mInput.Init(nullptr, &mTimer);
+		mInput.AddCursor("cursor", Mouse);
+		for (int i = 0; i < config.mControls; i++)
+		{
+			mInput.AddButton(ControlName("button", i).c_str(), Keyboard, i);
+			mInput.AddAxis(ControlName("axis", i).c_str(), Gamepad, i);
+			mInput.AddVirtualAxis(ControlName("virtual", i).c_str(), "cursor", i % 2 ? Vertical : Horizontal, ControlName("button", i).c_str(), 0.01f);
+		}
+
+		for (int i = 0; i < config.mControls; i++)
+		{
+			for (int j = 0; j < config.mBindingsPerControl; j++)
+			{
+				AddBindings(i);
+			}
+		}
+
+		for (int i = 0; i < config.mForwarders; i++)
+		{
+			auto forwarder = std::make_unique<InputForwarder>();
+			forwarder->Init(&mInput, [](ControllerType, int id, float) { sSink += id; }, [](ControllerType, int id) { sSink += id; }, [](ControllerType, int id) { sSink -= id; }, [](ControllerType, const KEngine2D::Point&) { sSink++; });
+			mForwarders.push_back(std::move(forwarder));
+		}
+	}
+
+	~BenchmarkFixture()
+	{
+		mForwarders.clear();
+		mButtonDowns.clear();
+		mButtonUps.clear();
+		mButtonHolds.clear();
+		mAxes.clear();
+		mCursors.clear();
+		mVirtualAxes.clear();
+		mInput.Deinit();
+	}
+
+	// Gives players 1 and up the same bindings as player 0, each on its own keyboard device.
+	void AddPlayers(int players)
+	{
+		for (int player = 1; player < players; player++)
+		{
+			mInput.AssignDevice(Keyboard, player, player);
+			mInput.SetBindingPlayer(player);
+			for (int i = 0; i < mConfig.mControls; i++)
+			{
+				for (int j = 0; j < mConfig.mBindingsPerControl; j++)
+				{
+					AddBindings(i);
+				}
+			}
+		}
+		mInput.SetBindingPlayer(0);
+	}
+
+	Input& GetInput() { return mInput; }
+	KEngineCore::Timer& GetTimer() { return mTimer; }
+	const BenchmarkConfig& GetConfig() const { return mConfig; }
+
+private:
+	void AddBindings(int control)
+	{
+		std::string button = ControlName("button", control);
+		std::string axis = ControlName("axis", control);
+
+		mButtonDowns.push_back(std::make_unique<ButtonDownBinding>());
+		mButtonDowns.back()->Init(&mInput, button.c_str(), []() { sSink++; });
+		mButtonUps.push_back(std::make_unique<ButtonUpBinding>());
+		mButtonUps.back()->Init(&mInput, button.c_str(), []() { sSink--; });
+		mButtonHolds.push_back(std::make_unique<ButtonHoldBinding>());
+		mButtonHolds.back()->Init(&mInput, &mTimer, button.c_str(), 10.0f, []() { sSink++; });
+		mAxes.push_back(std::make_unique<AxisBinding>());
+		mAxes.back()->Init(&mInput, &mTimer, axis.c_str(), 0.1f, 10.0f, [](float tilt) { sSink += (int)tilt; });
+		mCursors.push_back(std::make_unique<CursorPositionBinding>());
+		mCursors.back()->Init(&mInput, "cursor", [](const KEngine2D::Point& point) { sSink += (int)point.x; });
+		mVirtualAxes.push_back(std::make_unique<VirtualAxisBinding>());
+		mVirtualAxes.back()->Init(&mInput, ControlName("virtual", control).c_str(), [](float tilt) { sSink += (int)tilt; });
+	}
+
+	BenchmarkConfig		mConfig;
+	KEngineCore::Timer	mTimer;
+	Input				mInput;
+
+	std::vector<std::unique_ptr<ButtonDownBinding>>		mButtonDowns;
+	std::vector<std::unique_ptr<ButtonUpBinding>>		mButtonUps;
+	std::vector<std::unique_ptr<ButtonHoldBinding>>		mButtonHolds;
+	std::vector<std::unique_ptr<AxisBinding>>			mAxes;
+	std::vector<std::unique_ptr<CursorPositionBinding>>	mCursors;
+	std::vector<std::unique_ptr<VirtualAxisBinding>>	mVirtualAxes;
+	std::vector<std::unique_ptr<InputForwarder>>		mForwarders;
+};
+
+static void RunButtonDispatch(BenchmarkFixture& fixture)
+{
+	Input& input = fixture.GetInput();
+	const BenchmarkConfig& config = fixture.GetConfig();
+	// Warm up once so the dispatch table and any lazily grown storage exist before measuring.
+	input.HandleButtonDown(Keyboard, 0);
+	input.HandleButtonUp(Keyboard, 0);
+	Measure("HandleButtonDown/Up", config.mEvents, [&]() {
+		for (int i = 0; i < config.mEvents; i += 2)
+		{
+			int id = (i / 2) % config.mControls;
+			input.HandleButtonDown(Keyboard, id);
+			input.HandleButtonUp(Keyboard, id);
+		}
+	});
+	Measure("HandleButtonDown (unmapped)", config.mEvents, [&]() {
+		for (int i = 0; i < config.mEvents; i++)
+		{
+			input.HandleButtonDown(Joystick, i % config.mControls);
+		}
+	});
+}
+
+static void RunAxisDispatch(BenchmarkFixture& fixture)
+{
+	Input& input = fixture.GetInput();
+	const BenchmarkConfig& config = fixture.GetConfig();
+	input.HandleAxisChange(Gamepad, 0, 0.0f);
+	Measure("HandleAxisChange", config.mEvents, [&]() {
+		for (int i = 0; i < config.mEvents; i++)
+		{
+			input.HandleAxisChange(Gamepad, i % config.mControls, (i % 200) / 100.0f - 1.0f);
+		}
+	});
+}
+
+static void RunCursorDispatch(BenchmarkFixture& fixture)
+{
+	Input& input = fixture.GetInput();
+	const BenchmarkConfig& config = fixture.GetConfig();
+	input.HandleCursorPosition(Mouse, { 0.0, 0.0 });
+	Measure("HandleCursorPosition", config.mEvents, [&]() {
+		for (int i = 0; i < config.mEvents; i++)
+		{
+			input.HandleCursorPosition(Mouse, { (double)(i % 1000), (double)(i % 700) });
+		}
+	});
+}
+
+static void RunBatchedDispatch(BenchmarkFixture& fixture)
+{
+	Input& input = fixture.GetInput();
+	const BenchmarkConfig& config = fixture.GetConfig();
+	const int eventsPerFrame = 64;
+	std::vector<InputEvent> frame;
+	for (int i = 0; i < eventsPerFrame; i++)
+	{
+		frame.push_back({ AxisChangeEvent, Gamepad, i % 4, (i % 20) / 10.0f - 1.0f });
+		frame.push_back({ CursorPositionEvent, Mouse, 0, 0.0f, { (double)i, (double)i } });
+	}
+	input.SubmitEvents(frame);
+	input.Flush();
+	int frames = config.mEvents / (int)frame.size() + 1;
+	Measure("SubmitEvents+Flush (coalesced)", frames * (int)frame.size(), [&]() {
+		for (int i = 0; i < frames; i++)
+		{
+			input.SubmitEvents(frame);
+			input.Flush();
+		}
+	});
+}
+
+static void RunPauseResume(BenchmarkFixture& fixture)
+{
+	Input& input = fixture.GetInput();
+	const BenchmarkConfig& config = fixture.GetConfig();
+	const int eventsPerPause = 256;
+	input.Pause();
+	input.Resume();
+	int pauses = config.mEvents / eventsPerPause + 1;
+	Measure("Pause/Resume storm", pauses * eventsPerPause, [&]() {
+		for (int i = 0; i < pauses; i++)
+		{
+			input.Pause();
+			for (int j = 0; j < eventsPerPause; j += 4)
+			{
+				int id = j % config.mControls;
+				input.HandleButtonDown(Keyboard, id);
+				input.HandleAxisChange(Gamepad, id, 0.5f);
+				input.HandleCursorPosition(Mouse, { (double)j, 0.0 });
+				input.HandleButtonUp(Keyboard, (id + 1) % config.mControls);
+			}
+			input.Resume();
+		}
+	});
+}
+
+static void RunMultiplayerDispatch(BenchmarkFixture& fixture)
+{
+	Input& input = fixture.GetInput();
+	const BenchmarkConfig& config = fixture.GetConfig();
+	fixture.AddPlayers(Input::MaxPlayers);
+	input.HandleButtonDown(Keyboard, 0, Input::MaxPlayers - 1);
+	input.HandleButtonUp(Keyboard, 0, Input::MaxPlayers - 1);
+	Measure("HandleButtonDown/Up (8 players)", config.mEvents, [&]() {
+		for (int i = 0; i < config.mEvents; i += 2)
+		{
+			int id = (i / 2) % config.mControls;
+			int device = (i / 2) % Input::MaxPlayers;
+			input.HandleButtonDown(Keyboard, id, device);
+			input.HandleButtonUp(Keyboard, id, device);
+		}
+	});
+}
+
+static void RunBindingChurn(BenchmarkFixture& fixture)
+{
+	Input& input = fixture.GetInput();
+	const BenchmarkConfig& config = fixture.GetConfig();
+	std::string name = ControlName("button", 0);
+	KEngineCore::StringHash buttonName(name.c_str());
+	ButtonDownBinding binding;
+	binding.Init(&input, buttonName, []() { sSink++; });
+	binding.Deinit();
+	Measure("Bind/unbind churn", config.mEvents, [&]() {
+		for (int i = 0; i < config.mEvents; i++)
+		{
+			binding.Init(&input, buttonName, []() { sSink++; });
+			binding.Deinit();
+		}
+	});
+}
+
+static bool ParseArguments(int argc, char** argv, BenchmarkConfig& config)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		int* target = nullptr;
+		if (strcmp(argv[i], "--controls") == 0) target = &config.mControls;
+		else if (strcmp(argv[i], "--bindings") == 0) target = &config.mBindingsPerControl;
+		else if (strcmp(argv[i], "--forwarders") == 0) target = &config.mForwarders;
+		else if (strcmp(argv[i], "--events") == 0) target = &config.mEvents;
+		if (target == nullptr || i + 1 >= argc)
+		{
+			fprintf(stderr, "usage: %s [--controls N] [--bindings M] [--forwarders F] [--events E]\n", argv[0]);
+			return false;
+		}
+		*target = atoi(argv[++i]);
+	}
+	return config.mControls > 0 && config.mBindingsPerControl >= 0 && config.mForwarders >= 0 && config.mEvents > 0;
+}
+
+int main(int argc, char** argv)
+{
+	BenchmarkConfig config;
+	if (!ParseArguments(argc, argv, config))
+	{
+		return 1;
+	}
+
+	{
+		BenchmarkFixture fixture(config);
+		RunButtonDispatch(fixture);
+		RunAxisDispatch(fixture);
+		RunCursorDispatch(fixture);
+		RunBatchedDispatch(fixture);
+		RunPauseResume(fixture);
+		RunBindingChurn(fixture);
+		RunMultiplayerDispatch(fixture);
+	}
+
+	printf("controls=%d bindings/control/type=%d forwarders=%d events=%d\n", config.mControls, config.mBindingsPerControl, config.mForwarders, config.mEvents);
+	printf("%-32s %14s %14s %16s\n", "scenario", "ns/event", "allocs/event", "events/s");
+	for (const BenchmarkResult& result : sResults)
+	{
+		printf("%-32s %14.1f %14.3f %16.0f\n", result.mName, result.mNanosecondsPerEvent, result.mAllocationsPerEvent, result.mEventsPerSecond);
+	}
+	printf("(checksum %d)\n", sSink);
+	return 0;
+}
@@ -0,0 +1,124 @@
+// Headless check for the pause journal.  Pauses Input, feeds it far more events than the journal holds, and
+// after Resume compares every button's down/up state with what the events say it should be: overflowing the
+// journal may lose axis and cursor updates, but never a button press or release.
+//
+// Usage: KEngineBasicsInputPauseJournalCheck
+// Exits with 0 when every check passes.
+
+#include "Input.h"
+#include "Timer.h"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace KEngineBasics;
+
+static constexpr int ButtonCount = 24;
+static constexpr int AxisCount = 16;
+
+static int sFailures = 0;
+
+static void Check(bool condition, const char* scenario, const char* what)
+{
+	printf("%-36s %-36s %s\n", scenario, what, condition ? "ok" : "FAILED");
+	if (!condition)
+	{
+		sFailures++;
+	}
+}
+
+// Small deterministic generator, so every run checks the same sequences.
+static uint32_t sRandomState = 12345;
+
+static uint32_t NextRandom()
+{
+	sRandomState = sRandomState * 1664525u + 1013904223u;
+	return sRandomState >> 8;
+}
+
+static std::string ControlName(const char* prefix, int index)
+{
+	return std::string(prefix) + std::to_string(index);
+}
+
+// Runs pauses of eventsPerPause events each, mixing button toggles with axis and cursor noise, and checks the
+// published button states after each Resume.
+static void RunScenario(const char* scenario, size_t capacity, int coalescing, int buttonPercent, int eventsPerPause, bool expectOverflow)
+{
+	KEngineCore::Timer timer;
+	Input input;
+	input.SetPauseJournalCapacity(capacity);
+	input.Init(nullptr, &timer);
+	input.SetPauseCoalescing(coalescing);
+	input.AddCursor("pointer", Mouse);
+	for (int i = 0; i < ButtonCount; i++)
+	{
+		input.AddButton(ControlName("button", i).c_str(), Keyboard, i);
+	}
+	for (int i = 0; i < AxisCount; i++)
+	{
+		input.AddAxis(ControlName("axis", i).c_str(), Gamepad, i);
+	}
+
+	std::vector<bool> expectedDown(ButtonCount, false);
+	bool statesMatch = true;
+	for (int pause = 0; pause < 8; pause++)
+	{
+		input.Pause();
+		for (int event = 0; event < eventsPerPause; event++)
+		{
+			uint32_t roll = NextRandom();
+			if ((int)(roll % 100) < buttonPercent)
+			{
+				int button = (int)((roll >> 7) % ButtonCount);
+				if (expectedDown[button])
+				{
+					input.HandleButtonUp(Keyboard, button);
+				}
+				else
+				{
+					input.HandleButtonDown(Keyboard, button);
+				}
+				expectedDown[button] = !expectedDown[button];
+			}
+			else if (roll & 0x40)
+			{
+				input.HandleAxisChange(Gamepad, (int)((roll >> 7) % AxisCount), (float)(roll % 1000) / 1000.0f);
+			}
+			else
+			{
+				input.HandleCursorPosition(Mouse, { (double)(roll % 640), (double)(roll % 480) });
+			}
+		}
+		input.Resume();
+		input.SwapStateBuffers();
+
+		for (int i = 0; i < ButtonCount; i++)
+		{
+			if (input.GetState().IsDown(input.GetButtonIndex(ControlName("button", i).c_str())) != expectedDown[i])
+			{
+				statesMatch = false;
+			}
+		}
+	}
+	Check(statesMatch, scenario, "every button down/up as sent");
+	if (expectOverflow)
+	{
+		Check(input.GetPauseJournalOverflowCount() > 0, scenario, "axis or cursor updates overflowed");
+	}
+	input.Deinit();
+}
+
+int main()
+{
+	RunScenario("no coalescing, mostly axes", 16, PauseCoalesceNone, 20, 400, true);
+	RunScenario("no coalescing, mostly buttons", 16, PauseCoalesceNone, 90, 400, true);
+	RunScenario("no coalescing, only buttons", 8, PauseCoalesceNone, 100, 200, false);
+	RunScenario("continuous coalescing", 16, PauseCoalesceContinuous, 30, 400, false);
+	RunScenario("full coalescing", 8, PauseCoalesceContinuous | PauseCoalesceButtonPairs, 50, 1000, false);
+	RunScenario("button pair coalescing", 8, PauseCoalesceButtonPairs, 40, 1000, true);
+
+	printf("%s\n", sFailures == 0 ? "all checks passed" : "some checks FAILED");
+	return sFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,112 @@
+// Headless loopback check for InputStreamWriter and InputStreamReader.  Streams events from one Input to
+// another over a pipe and over a Unix domain socket pair, then closes the reading end and keeps writing: the
+// writer must notice the reader has gone without the process being killed by SIGPIPE.
+//
+// Usage: KEngineBasicsInputStreamLoopback
+// Exits with 0 when every check passes.
+
+#include "Input.h"
+#include "InputStream.h"
+#include "Timer.h"
+#include <csignal>
+#include <cstdio>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace KEngineBasics;
+
+static int sFailures = 0;
+
+static void Check(bool condition, const char* transport, const char* what)
+{
+	printf("%-8s %-40s %s\n", transport, what, condition ? "ok" : "FAILED");
+	if (!condition)
+	{
+		sFailures++;
+	}
+}
+
+static void AddControls(Input& input)
+{
+	input.AddButton("jump", Keyboard, 1);
+	input.AddAxis("throttle", Gamepad, 2);
+	input.AddCursor("pointer", Mouse);
+}
+
+static bool IsPipeSignalPending()
+{
+	sigset_t pending;
+	sigemptyset(&pending);
+	sigpending(&pending);
+	return sigismember(&pending, SIGPIPE) == 1;
+}
+
+// writeEnd and readEnd are connected; both are handed over to the writer and reader.
+static void RunLoopback(const char* transport, int writeEnd, int readEnd)
+{
+	KEngineCore::Timer timer;
+	Input source;
+	Input destination;
+	source.Init(nullptr, &timer);
+	destination.Init(nullptr, &timer);
+	AddControls(source);
+	AddControls(destination);
+
+	int jumps = 0;
+	ButtonDownBinding jumpBinding;
+	jumpBinding.Init(&destination, "jump", [&jumps]() { jumps++; });
+
+	InputStreamWriter writer;
+	InputStreamReader reader;
+	Check(writer.Init(&source, writeEnd), transport, "writer init");
+	Check(reader.Init(&destination, readEnd), transport, "reader init");
+
+	source.HandleButtonDown(Keyboard, 1);
+	source.HandleButtonUp(Keyboard, 1);
+	source.HandleAxisChange(Gamepad, 2, 0.5f);
+	source.HandleCursorPosition(Mouse, { 10.0, 20.0 });
+	writer.SendFrame();
+	Check(reader.Update() == 4, transport, "every event arrives");
+	Check(jumps == 1, transport, "bindings fire on the reading side");
+	Check(!reader.HasFailed(), transport, "stream decodes");
+
+	// With the reader gone, the writer must close its end rather than raise SIGPIPE.
+	reader.Deinit();
+	for (int frame = 0; frame < 4; frame++)
+	{
+		source.HandleButtonDown(Keyboard, 1);
+		source.HandleButtonUp(Keyboard, 1);
+		writer.SendFrame();
+	}
+	Check(!IsPipeSignalPending(), transport, "no SIGPIPE left pending");
+
+	writer.Deinit();
+	jumpBinding.Deinit();
+	destination.Deinit();
+	source.Deinit();
+}
+
+int main()
+{
+	// Left at its default action, a stray SIGPIPE would end the process here and fail the check.
+	signal(SIGPIPE, SIG_DFL);
+
+	int pipeEnds[2];
+	if (pipe(pipeEnds) != 0)
+	{
+		perror("pipe");
+		return 1;
+	}
+	RunLoopback("pipe", pipeEnds[1], pipeEnds[0]);
+
+	int socketEnds[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, socketEnds) != 0)
+	{
+		perror("socketpair");
+		return 1;
+	}
+	RunLoopback("socket", socketEnds[0], socketEnds[1]);
+
+	printf("%s\n", sFailures == 0 ? "all checks passed" : "some checks FAILED");
+	return sFailures == 0 ? 0 : 1;
+}